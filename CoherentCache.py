@@ -3,15 +3,69 @@ from m5.proxy import *
 from m5.SimObject import SimObject
 
 
+class CoherentReplPolicy(ScopedEnum):
+    vals = ['LRU', 'TreePLRU', 'SRRIP', 'BRRIP', 'Random']
+
+
+class CoherentRangeMode(ScopedEnum):
+    vals = ['WriteBack', 'WriteThrough', 'Uncached']
+
+
+class CoherentArbitration(ScopedEnum):
+    vals = ['FIFO', 'RoundRobin', 'FixedPriority', 'AgeBased', 'Weighted']
+
+
+class CoherentDirectoryFormat(ScopedEnum):
+    vals = ['FullBitVector', 'LimitedPointer']
+
+
+class CoherentPrefetchPolicy(ScopedEnum):
+    vals = ['Disabled', 'NextLine', 'Stride', 'Stream']
+
+
 class CoherentCacheBase(SimObject):
     type = 'CoherentCacheBase'
     cxx_header = 'src_740/coherent_cache_base.hh'
     cxx_class = 'gem5::CoherentCacheBase'
 
     cpu_side = ResponsePort('CPU side port, receives reqs')
-    serializing_bus = Param.SerializingBus('serializing cache coherence bus')
+    serializing_bus = VectorParam.SerializingBus(
+        'coherence bus slices, lines are interleaved across them by block')
     cache_id = Param.Int(0, 'unique id of private cache in system')
 
+    cacheable_ranges = VectorParam.AddrRange([AddrRange(0x8000, size=0x100)],
+        'address ranges handled coherently, all others bypass the cache')
+    cacheable_range_modes = VectorParam.CoherentRangeMode([],
+        'write policy per cacheable range, missing entries are WriteBack')
+
+    size = Param.MemorySize('4kB', 'capacity of the cache')
+    block_size = Param.Unsigned(Parent.cache_line_size, 'line size in bytes')
+    assoc = Param.Unsigned(4, 'number of ways per set')
+    sets = Param.Unsigned(0, 'number of sets (0: derive from size and assoc)')
+    replacement_policy = Param.CoherentReplPolicy('LRU',
+                                                  'victim selection policy')
+    mshrs = Param.Unsigned(4, 'number of outstanding misses')
+    tgts_per_mshr = Param.Unsigned(8, 'CPU requests that can wait per miss')
+    writeback_buffer_size = Param.Unsigned(8,
+        'dirty lines that can wait for the bus before the cache stalls')
+    trace = Param.CoherenceTrace(NULL, 'records accesses, fills and snoops')
+
+    tag_latency = Param.Latency('1ns', 'tag lookup of a CPU access')
+    data_latency = Param.Latency('1ns', 'data array read or write')
+    response_latency = Param.Latency('1ns',
+                                     'from the data array back to the CPU')
+    snoop_latency = Param.Latency('1ns', 'tag lookup of a snooped request')
+
+    prefetcher = Param.CoherentPrefetchPolicy('Disabled',
+        'prefetch engine trained by demand accesses, not for MiCache')
+    prefetch_degree = Param.Unsigned(2, 'blocks suggested per trigger')
+    prefetch_queue_size = Param.Unsigned(8,
+        'prefetches waiting for an idle bus, further ones are dropped')
+    prefetch_table_entries = Param.Unsigned(16,
+        'Stride: table entries, Stream: streams tracked')
+    prefetch_stride_by_pc = Param.Bool(True,
+        'Stride: index by PC, by 4kB region if false or without a PC')
+
 
 class SerializingBus(SimObject):
     type = 'SerializingBus'
@@ -19,6 +73,62 @@ class SerializingBus(SimObject):
     cxx_class = 'gem5::SerializingBus'
 
     mem_side = RequestPort('Mem side port, talks to memory')
+    forward_clean = Param.Bool(True,
+        'let caches holding a line clean (E or S) supply it on a snoop')
+    split_transaction = Param.Bool(False,
+        'hand the bus on after the snoop phase instead of holding it until '
+        'the memory response')
+    max_outstanding = Param.Unsigned(8,
+        'transactions past their snoop phase in split transaction mode')
+    block_size = Param.Unsigned(Parent.cache_line_size,
+        'line size, transactions to the same line are kept in order')
+    directory = Param.CoherenceDirectory(NULL,
+        'snoop only the sharers it tracks instead of broadcasting')
+    snoop_filter_entries = Param.Unsigned(0,
+        'lines tracked by the inclusive snoop filter, 0 broadcasts')
+    snoop_filter_assoc = Param.Unsigned(8, 'ways per snoop filter set')
+    arbitration = Param.CoherentArbitration('FIFO',
+                                            'which bus request is granted next')
+    arbiter_priorities = VectorParam.Unsigned([],
+        'FixedPriority: level per cache_id (0-63, higher wins), default 0')
+    arbiter_weights = VectorParam.Unsigned([],
+        'Weighted: grants in a row per cache_id, default 1')
+    trace = Param.CoherenceTrace(NULL, 'records every transaction started')
+
+    arbitration_latency = Param.Latency('1ns',
+        'from a request or the bus becoming free to the next grant')
+    bus_width = Param.Unsigned(8, 'bytes moved per transfer beat')
+    transfer_latency = Param.Latency('1ns',
+        'per beat, a block takes block_size / bus_width beats')
+
+
+class CoherenceDirectory(SimObject):
+    type = 'CoherenceDirectory'
+    cxx_header = 'src_740/coherence_directory.hh'
+    cxx_class = 'gem5::CoherenceDirectory'
+
+    format = Param.CoherentDirectoryFormat('FullBitVector',
+                                           'sharer encoding per line')
+    max_caches = Param.Unsigned(64, 'cache ids must be below this (<= 64)')
+    entries = Param.Unsigned(16384,
+        'lines tracked, a fill into a full set makes the set broadcast '
+        'until that line is dropped again')
+    assoc = Param.Unsigned(8, 'ways per directory set')
+    block_size = Param.Unsigned(Parent.cache_line_size,
+                                'line size in bytes, the same as the bus')
+    num_pointers = Param.Unsigned(4,
+        'LimitedPointer: sharers tracked before falling back to broadcast')
+
+
+class CoherenceTrace(SimObject):
+    type = 'CoherenceTrace'
+    cxx_header = 'src_740/coherence_trace.hh'
+    cxx_class = 'gem5::CoherenceTrace'
+
+    file = Param.String('coherence.trace',
+                        'binary trace file in the output directory')
+    buffer_records = Param.Unsigned(4096,
+        'records buffered in memory between writes')
 
 
 class MiCache(CoherentCacheBase):
@@ -36,4 +146,22 @@ class MsiCache(CoherentCacheBase):
 class MesiCache(CoherentCacheBase):
     type = 'MesiCache'
     cxx_header = 'src_740/mesi_cache.hh'
-    cxx_class = 'gem5::MesiCache'
\ No newline at end of file
+    cxx_class = 'gem5::MesiCache'
+
+
+class MoesiCache(CoherentCacheBase):
+    type = 'MoesiCache'
+    cxx_header = 'src_740/moesi_cache.hh'
+    cxx_class = 'gem5::MoesiCache'
+
+
+class DragonCache(CoherentCacheBase):
+    type = 'DragonCache'
+    cxx_header = 'src_740/dragon_cache.hh'
+    cxx_class = 'gem5::DragonCache'
+
+
+class MesifCache(CoherentCacheBase):
+    type = 'MesifCache'
+    cxx_header = 'src_740/mesif_cache.hh'
+    cxx_class = 'gem5::MesifCache'
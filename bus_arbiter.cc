@@ -0,0 +1,124 @@
+#include "src_740/bus_arbiter.hh"
+#include "base/logging.hh"
+
+namespace gem5 {
+
+std::unique_ptr<BusArbiter> BusArbiter::create(
+    enums::CoherentArbitration type,
+    const std::vector<unsigned>& priorities,
+    const std::vector<unsigned>& weights) {
+    switch (type) {
+      case enums::CoherentArbitration::FIFO:
+        return std::make_unique<FifoArbiter>();
+      case enums::CoherentArbitration::RoundRobin:
+        return std::make_unique<WeightedArbiter>(std::vector<unsigned>());
+      case enums::CoherentArbitration::FixedPriority:
+        return std::make_unique<FixedPriorityArbiter>(priorities);
+      case enums::CoherentArbitration::AgeBased:
+        return std::make_unique<AgeArbiter>();
+      case enums::CoherentArbitration::Weighted:
+        return std::make_unique<WeightedArbiter>(weights);
+      default:
+        panic("unknown arbitration policy %d\n", static_cast<int>(type));
+    }
+}
+
+void FifoArbiter::request(int cacheId, Tick now, Tick since) {
+    tokens.push_back({cacheId, now});
+    pending++;
+}
+
+int FifoArbiter::grant(Tick now, Tick& waited) {
+    assert(!tokens.empty());
+    auto token = tokens.front();
+    tokens.pop_front();
+    pending--;
+    waited = now - token.second;
+    return token.first;
+}
+
+unsigned WeightedArbiter::weight(int cacheId) const {
+    if (cacheId < (int)weights.size() && weights[cacheId] > 0) {
+        return weights[cacheId];
+    }
+    return 1;
+}
+
+void WeightedArbiter::request(int cacheId, Tick now, Tick since) {
+    if (cacheId >= (int)caches.size()) {
+        caches.resize(cacheId + 1);
+    }
+    CacheTokens& cache = caches[cacheId];
+    if (cache.queued.empty()) {
+        turns.push_back(cacheId);
+    }
+    cache.queued.push_back(now);
+    pending++;
+}
+
+int WeightedArbiter::grant(Tick now, Tick& waited) {
+    assert(!turns.empty());
+    int cacheId = turns.front();
+    CacheTokens& cache = caches[cacheId];
+    waited = now - cache.queued.front();
+    cache.queued.pop_front();
+    pending--;
+
+    // the turn ends when the weight is used up or the cache is idle
+    if (++cache.used >= weight(cacheId) || cache.queued.empty()) {
+        cache.used = 0;
+        turns.pop_front();
+        if (!cache.queued.empty()) {
+            turns.push_back(cacheId);
+        }
+    }
+    return cacheId;
+}
+
+FixedPriorityArbiter::FixedPriorityArbiter(
+    const std::vector<unsigned>& priorities)
+    : priorities(priorities), levels(numLevels) {
+    for (auto prio : priorities) {
+        fatal_if(prio >= numLevels,
+                 "bus priority %d out of range, at most %d levels\n",
+                 prio, numLevels);
+    }
+}
+
+void FixedPriorityArbiter::request(int cacheId, Tick now, Tick since) {
+    unsigned prio =
+        cacheId < (int)priorities.size() ? priorities[cacheId] : 0;
+    levels[prio].push_back({cacheId, now});
+    nonEmpty |= uint64_t(1) << prio;
+    pending++;
+}
+
+int FixedPriorityArbiter::grant(Tick now, Tick& waited) {
+    assert(nonEmpty != 0);
+    unsigned prio = 63 - __builtin_clzll(nonEmpty);
+    auto& level = levels[prio];
+    auto token = level.front();
+    level.pop_front();
+    if (level.empty()) {
+        nonEmpty &= ~(uint64_t(1) << prio);
+    }
+    pending--;
+    waited = now - token.second;
+    return token.first;
+}
+
+void AgeArbiter::request(int cacheId, Tick now, Tick since) {
+    tokens.push({since, nextSeq++, cacheId, now});
+    pending++;
+}
+
+int AgeArbiter::grant(Tick now, Tick& waited) {
+    assert(!tokens.empty());
+    Token token = tokens.top();
+    tokens.pop();
+    pending--;
+    waited = now - token.queued;
+    return token.cacheId;
+}
+
+}
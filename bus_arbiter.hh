@@ -0,0 +1,115 @@
+#pragma once
+
+#include "base/types.hh"
+#include "enums/CoherentArbitration.hh"
+#include "src_740/ring_queue.hh"
+
+#include <cstdint>
+#include <memory>
+#include <queue>
+#include <vector>
+
+namespace gem5 {
+
+// Decides which cache SerializingBus grants next. Every bus request is
+// one token, a cache can have several queued. Tokens remember when they
+// were queued so the bus can record how long each grant waited.
+// Grants are O(1), except AgeBased which keeps a heap.
+class BusArbiter {
+   public:
+    virtual ~BusArbiter() {}
+
+    // queues a token for cacheId. since is when the work behind it first
+    // needed the bus, e.g. a reissued MSHR keeps its allocation time.
+    virtual void request(int cacheId, Tick now, Tick since) = 0;
+
+    // removes the next token, returns its cache and how long it waited
+    virtual int grant(Tick now, Tick &waited) = 0;
+
+    bool empty() const { return pending == 0; }
+    size_t size() const { return pending; }
+
+    // priorities and weights are indexed by cache id, missing entries
+    // are priority 0 and weight 1
+    static std::unique_ptr<BusArbiter> create(
+        enums::CoherentArbitration type,
+        const std::vector<unsigned> &priorities,
+        const std::vector<unsigned> &weights);
+
+   protected:
+    size_t pending = 0;
+};
+
+// grants tokens in the order they were queued
+class FifoArbiter : public BusArbiter {
+   public:
+    void request(int cacheId, Tick now, Tick since) override;
+    int grant(Tick now, Tick &waited) override;
+
+   private:
+    RingQueue<std::pair<int, Tick>> tokens;
+};
+
+// caches with tokens take turns, each one gets up to its weight grants
+// in a row. With all weights 1 this is plain round-robin.
+class WeightedArbiter : public BusArbiter {
+   public:
+    WeightedArbiter(const std::vector<unsigned> &weights)
+        : weights(weights) {}
+
+    void request(int cacheId, Tick now, Tick since) override;
+    int grant(Tick now, Tick &waited) override;
+
+   private:
+    struct CacheTokens {
+        RingQueue<Tick> queued;
+        unsigned used = 0;  // grants in the current turn
+    };
+    std::vector<unsigned> weights;
+    std::vector<CacheTokens> caches;  // by cache id
+    RingQueue<int> turns;  // caches with tokens, the front one is served
+
+    unsigned weight(int cacheId) const;
+};
+
+// the highest priority cache with a token wins, ties are FIFO.
+// Up to 64 levels, a bit per non-empty level finds the highest in O(1).
+class FixedPriorityArbiter : public BusArbiter {
+   public:
+    static constexpr unsigned numLevels = 64;
+
+    FixedPriorityArbiter(const std::vector<unsigned> &priorities);
+
+    void request(int cacheId, Tick now, Tick since) override;
+    int grant(Tick now, Tick &waited) override;
+
+   private:
+    std::vector<unsigned> priorities;
+    std::vector<RingQueue<std::pair<int, Tick>>> levels;
+    uint64_t nonEmpty = 0;
+};
+
+// the token whose work has waited longest since it first needed the bus
+// wins, so reissued misses keep their seniority
+class AgeArbiter : public BusArbiter {
+   public:
+    void request(int cacheId, Tick now, Tick since) override;
+    int grant(Tick now, Tick &waited) override;
+
+   private:
+    struct Token {
+        Tick since;
+        uint64_t seq;  // FIFO among equal ages
+        int cacheId;
+        Tick queued;
+
+        bool operator>(const Token &other) const {
+            return since != other.since ? since > other.since
+                                        : seq > other.seq;
+        }
+    };
+    uint64_t nextSeq = 0;
+    std::priority_queue<Token, std::vector<Token>, std::greater<Token>>
+        tokens;
+};
+}
@@ -0,0 +1,74 @@
+# Host speed of the coherent caches: MemTest testers share lines through
+# private caches on one bus, the result is simulated bus transactions per
+# host second. Run it on two builds to compare them, e.g.
+#   build/X86/gem5.opt src/src_740/coherence_bench.py --protocol Mesi
+
+import argparse
+import os
+import time
+
+import m5
+from m5.objects import *
+
+parser = argparse.ArgumentParser()
+parser.add_argument('--protocol', default='Mesi',
+                    choices=['Mi', 'Msi', 'Mesi', 'Moesi', 'Dragon',
+                             'Mesif'])
+parser.add_argument('--cpus', type=int, default=4)
+parser.add_argument('--loads', type=int, default=200000,
+                    help='the run ends when a tester has done this many')
+parser.add_argument('--split', action='store_true',
+                    help='split transaction bus')
+args = parser.parse_args()
+
+system = System()
+system.clk_domain = SrcClockDomain(clock='1GHz',
+                                   voltage_domain=VoltageDomain())
+system.mem_mode = 'timing'
+system.mem_ranges = [AddrRange('512MB')]
+
+system.bus = SerializingBus(split_transaction=args.split)
+system.membus = SystemXBar()
+system.bus.mem_side = system.membus.cpu_side_ports
+system.system_port = system.membus.cpu_side_ports
+system.mem_ctrl = SimpleMemory(range=system.mem_ranges[0])
+system.mem_ctrl.port = system.membus.mem_side_ports
+
+# every access is cacheable, MemTest picks from two small regions so the
+# caches keep stealing lines from each other
+regions = [AddrRange(0x100000, size='64kB'), AddrRange(0x400000, size='64kB')]
+cache_class = getattr(m5.objects, args.protocol + 'Cache')
+testers = []
+caches = []
+for i in range(args.cpus):
+    tester = MemTest(max_loads=args.loads, percent_functional=0,
+                     percent_uncacheable=0)
+    cache = cache_class(cache_id=i, serializing_bus=[system.bus],
+                        cacheable_ranges=regions)
+    tester.port = cache.cpu_side
+    testers.append(tester)
+    caches.append(cache)
+system.testers = testers
+system.caches = caches
+
+root = Root(full_system=False, system=system)
+m5.instantiate()
+
+start = time.time()
+event = m5.simulate()
+host_seconds = time.time() - start
+m5.stats.dump()
+
+transactions = 0
+bus_bytes = 0
+with open(os.path.join(m5.options.outdir, 'stats.txt')) as stats:
+    for line in stats:
+        if line.startswith('system.bus.transactions::total'):
+            transactions = int(float(line.split()[1]))
+        elif line.startswith('system.bus.bytes::total'):
+            bus_bytes = int(float(line.split()[1]))
+
+print('%s at tick %d' % (event.getCause(), m5.curTick()))
+print('%d bus transactions in %.2f host seconds, %.0f per host second' %
+      (transactions, host_seconds, transactions / host_seconds))
+print('%d bytes on the bus' % bus_bytes)
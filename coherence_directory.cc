@@ -0,0 +1,150 @@
+#include "src_740/coherence_directory.hh"
+#include "base/bitfield.hh"
+#include "base/intmath.hh"
+#include "base/logging.hh"
+#include "base/trace.hh"
+#include "debug/CDir.hh"
+
+namespace gem5 {
+
+CoherenceDirectory::CoherenceDirectory(const CoherenceDirectoryParams& params)
+    : SimObject(params),
+      format(params.format),
+      maxCaches(params.max_caches),
+      numPointers(params.num_pointers),
+      assoc(params.assoc),
+      stats(this) {
+    fatal_if(maxCaches == 0 || maxCaches > 64,
+             "%s: max_caches must be 1-64\n", name());
+    fatal_if(format == enums::CoherentDirectoryFormat::LimitedPointer &&
+             numPointers == 0,
+             "%s: limited pointer format needs num_pointers > 0\n", name());
+    fatal_if(!isPowerOf2(params.block_size),
+             "%s: block size must be a power of 2\n", name());
+    blkBits = floorLog2(params.block_size);
+    fatal_if(assoc == 0 || params.entries % assoc,
+             "%s: entries must be a multiple of assoc\n", name());
+    numSets = params.entries / assoc;
+    fatal_if(!isPowerOf2(numSets),
+             "%s: number of sets must be a power of 2\n", name());
+
+    tags.assign(params.entries, 0);
+    sharerBits.assign(params.entries, 0);
+    overflowed.assign(params.entries, 0);
+    untracked.assign(numSets, 0);
+}
+
+CoherenceDirectory::DirectoryStats::DirectoryStats(statistics::Group *parent)
+    : statistics::Group(parent),
+      ADD_STAT(lookups, statistics::units::Count::get(),
+               "snooped transactions looked up in the directory"),
+      ADD_STAT(snoopsSent, statistics::units::Count::get(),
+               "point-to-point snoops sent to sharers"),
+      ADD_STAT(broadcasts, statistics::units::Count::get(),
+               "lookups that hit an overflowed entry and broadcast"),
+      ADD_STAT(overflows, statistics::units::Count::get(),
+               "limited pointer entries that ran out of pointers"),
+      ADD_STAT(untrackedFills, statistics::units::Count::get(),
+               "fills into a full set, the set broadcasts until dropped")
+{
+}
+
+int CoherenceDirectory::findEntry(Addr blk) const {
+    unsigned base = setIndex(blk) * assoc;
+    for (unsigned way = 0; way < assoc; way++) {
+        unsigned entry = base + way;
+        if (!isFree(entry) && tags[entry] == blk) {
+            return entry;
+        }
+    }
+    return -1;
+}
+
+bool CoherenceDirectory::sharers(Addr blk, int requester,
+                                 std::vector<int>& targets) {
+    stats.lookups++;
+    int entry = findEntry(blk);
+    if (entry < 0 && untracked[setIndex(blk)] == 0) {
+        return true;
+    }
+
+    if (entry < 0 || overflowed[entry]) {
+        DPRINTF(CDir, "%#x not tracked, broadcasting\n\n", blk);
+        stats.broadcasts++;
+        return false;
+    }
+
+    uint64_t holders = sharerBits[entry] & ~(uint64_t(1) << requester);
+    for (; holders; holders &= holders - 1) {
+        targets.push_back(__builtin_ctzll(holders));
+    }
+    stats.snoopsSent += targets.size();
+    return true;
+}
+
+void CoherenceDirectory::addSharer(Addr blk, int cacheId) {
+    fatal_if(cacheId < 0 || cacheId >= (int)maxCaches,
+             "%s: cache_id %d exceeds max_caches\n", name(), cacheId);
+    DPRINTF(CDir, "%#x add sharer %d\n\n", blk, cacheId);
+    uint64_t bit = uint64_t(1) << cacheId;
+    unsigned set = setIndex(blk);
+    int entry = findEntry(blk);
+    if (entry < 0) {
+        // a new entry in a set with untracked lines could hide them
+        unsigned base = set * assoc;
+        for (unsigned way = 0; way < assoc && !untracked[set]; way++) {
+            if (isFree(base + way)) {
+                entry = base + way;
+                break;
+            }
+        }
+        if (entry < 0) {
+            DPRINTF(CDir, "%#x set %d full, not tracked\n\n", blk, set);
+            stats.untrackedFills++;
+            untracked[set]++;
+            return;
+        }
+        tags[entry] = blk;
+    }
+
+    if (overflowed[entry] || (sharerBits[entry] & bit)) {
+        return;
+    }
+    if (format == enums::CoherentDirectoryFormat::LimitedPointer &&
+        unsigned(popCount(sharerBits[entry])) >= numPointers) {
+        // the sharers are no longer known, fall back to broadcast
+        DPRINTF(CDir, "%#x out of pointers\n\n", blk);
+        stats.overflows++;
+        overflowed[entry] = 1;
+        sharerBits[entry] = 0;
+        return;
+    }
+    sharerBits[entry] |= bit;
+}
+
+void CoherenceDirectory::removeSharer(Addr blk, int cacheId) {
+    DPRINTF(CDir, "%#x remove sharer %d\n\n", blk, cacheId);
+    int entry = findEntry(blk);
+    if (entry >= 0) {
+        sharerBits[entry] &= ~(uint64_t(1) << cacheId);
+        return;
+    }
+    // every fill is dropped once, a line without an entry was untracked
+    unsigned set = setIndex(blk);
+    if (untracked[set]) {
+        untracked[set]--;
+    }
+}
+
+void CoherenceDirectory::ownershipTaken(Addr blk, int requester) {
+    // a precise entry already dropped the invalidated caches
+    int entry = findEntry(blk);
+    if (entry < 0 || !overflowed[entry]) {
+        return;
+    }
+    DPRINTF(CDir, "%#x owned by %d, overflow cleared\n\n", blk, requester);
+    overflowed[entry] = 0;
+    sharerBits[entry] = uint64_t(1) << requester;
+}
+
+}
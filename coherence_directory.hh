@@ -0,0 +1,77 @@
+#pragma once
+
+#include "base/statistics.hh"
+#include "base/types.hh"
+#include "enums/CoherentDirectoryFormat.hh"
+#include "params/CoherenceDirectory.hh"
+#include "sim/sim_object.hh"
+
+#include <cstdint>
+#include <vector>
+
+namespace gem5 {
+
+// Tracks which private caches may hold each line, so SerializingBus can
+// snoop only those instead of broadcasting. Caches report their own fills
+// and drops through the bus, a line stays tracked while the cache still
+// has it or a writeback of it buffered.
+//
+// FullBitVector keeps one presence bit per cache and is always precise.
+// LimitedPointer tracks up to num_pointers sharers per line. A line with
+// more sharers overflows and is broadcast until an ownership request
+// invalidates every other copy. Both keep the sharers in one 64-bit word,
+// like SnoopFilter, so at most 64 caches.
+//
+// Entries are set-associative and never replaced: a line dropped by all
+// its sharers frees its entry. A fill into a full set is not tracked, and
+// lines of that set without an entry are broadcast until every untracked
+// fill has been dropped again.
+class CoherenceDirectory : public SimObject {
+   public:
+    CoherenceDirectory(const CoherenceDirectoryParams &params);
+
+    // fills targets with the caches other than requester that may hold
+    // blk. Returns false if the entry overflowed and all caches need to
+    // be snooped.
+    bool sharers(Addr blk, int requester, std::vector<int> &targets);
+
+    void addSharer(Addr blk, int cacheId);
+    void removeSharer(Addr blk, int cacheId);
+
+    // an ownership request was broadcast, requester is now the only cache
+    // that can hold blk
+    void ownershipTaken(Addr blk, int requester);
+
+    unsigned blockSize() const { return 1 << blkBits; }
+
+   private:
+    const enums::CoherentDirectoryFormat format;
+    const unsigned maxCaches;
+    const unsigned numPointers;
+    unsigned numSets;
+    unsigned assoc;
+    unsigned blkBits;
+    std::vector<Addr> tags;
+    std::vector<uint64_t> sharerBits;
+    std::vector<uint8_t> overflowed;  // the sharers are no longer known
+    std::vector<unsigned> untracked;  // per set, fills without an entry
+
+    unsigned setIndex(Addr blk) const {
+        return (blk >> blkBits) & (numSets - 1);
+    }
+    bool isFree(unsigned entry) const {
+        return sharerBits[entry] == 0 && !overflowed[entry];
+    }
+    int findEntry(Addr blk) const;
+
+    struct DirectoryStats : public statistics::Group {
+        DirectoryStats(statistics::Group *parent);
+
+        statistics::Scalar lookups;
+        statistics::Scalar snoopsSent;
+        statistics::Scalar broadcasts;
+        statistics::Scalar overflows;
+        statistics::Scalar untrackedFills;
+    } stats;
+};
+}
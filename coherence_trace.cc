@@ -0,0 +1,46 @@
+#include "src_740/coherence_trace.hh"
+#include "base/logging.hh"
+#include "sim/sim_exit.hh"
+
+#include <cstring>
+
+namespace gem5 {
+
+CoherenceTrace::CoherenceTrace(const CoherenceTraceParams& params)
+    : SimObject(params),
+      stream(simout.create(params.file, true)),
+      bufferRecords(params.buffer_records) {
+    fatal_if(bufferRecords == 0,
+             "%s: buffer_records must be at least 1\n", name());
+    buffer.reserve(bufferRecords);
+
+    Header header{};
+    std::memcpy(header.magic, "CCTRACE", 8);
+    header.version = 1;
+    header.recordSize = sizeof(Record);
+    header.numCmds = MemCmd::NUM_MEM_CMDS;
+    std::ostream& os = *stream->stream();
+    os.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    for (int i = 0; i < MemCmd::NUM_MEM_CMDS; i++) {
+        const std::string& cmdName =
+            MemCmd(static_cast<MemCmd::Command>(i)).toString();
+        os.write(cmdName.c_str(), cmdName.size() + 1);
+    }
+
+    registerExitCallback([this]() {
+        flush();
+        simout.close(stream);
+        stream = nullptr;
+    });
+}
+
+void CoherenceTrace::flush() {
+    if (buffer.empty() || !stream) {
+        return;
+    }
+    stream->stream()->write(reinterpret_cast<const char*>(buffer.data()),
+                            buffer.size() * sizeof(Record));
+    buffer.clear();
+}
+
+}
@@ -0,0 +1,82 @@
+#pragma once
+
+#include "base/output.hh"
+#include "base/types.hh"
+#include "mem/packet.hh"
+#include "params/CoherenceTrace.hh"
+#include "sim/sim_object.hh"
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+namespace gem5 {
+
+// Records coherence events from the caches and bus slices pointing at it
+// as fixed-size binary records, buffered in memory and written out in
+// blocks. Nothing is formatted while simulating, decode the file with
+// decode_coherence_trace.py.
+//
+// File layout, little endian: the header, the MemCmd names as
+// NUL-terminated strings indexed by command, then the records.
+class CoherenceTrace : public SimObject {
+   public:
+    enum Event : uint8_t {
+        CpuHit,  // CPU access served from the line
+        CpuMiss,  // CPU access needs the bus, or merged into an MSHR
+        Fill,  // a cache's transaction completed, latency since the miss
+        Uncacheable,  // uncached access completed
+        Snoop,  // a cache saw another cache's transaction
+        Writeback,  // a buffered writeback went on the bus
+        Transaction,  // a bus slice started a transaction
+    };
+
+    // snoop result bits
+    static const uint8_t SnoopHit = 1;  // a snooped cache held the line
+    static const uint8_t SnoopSupplied = 2;  // a cache supplied the data
+    static const uint8_t SnoopInvalidated = 4;  // the snoop dropped a copy
+
+    struct Header {
+        char magic[8];
+        uint32_t version;
+        uint32_t recordSize;
+        uint32_t numCmds;
+        uint32_t reserved;
+    };
+
+    struct Record {
+        uint64_t tick;
+        uint64_t addr;
+        uint32_t latency;  // ticks, saturated
+        int16_t cacheId;  // the requester for Transaction records
+        uint8_t event;
+        uint8_t cmd;  // MemCmd::Command
+        uint8_t stateBefore;  // protocol specific, 0 is Invalid
+        uint8_t stateAfter;
+        uint8_t snoop;
+        uint8_t reserved[5];
+    };
+    static_assert(sizeof(Record) == 32, "trace records are 32 bytes");
+
+    CoherenceTrace(const CoherenceTraceParams &params);
+
+    void record(Event event, int cacheId, Addr addr, MemCmd cmd,
+                uint8_t stateBefore, uint8_t stateAfter, uint8_t snoop = 0,
+                Tick latency = 0) {
+        if (buffer.size() == bufferRecords) {
+            flush();
+        }
+        buffer.push_back({curTick(), addr,
+                          uint32_t(std::min<Tick>(latency, UINT32_MAX)),
+                          int16_t(cacheId), event, uint8_t(cmd.toInt()),
+                          stateBefore, stateAfter, snoop, {}});
+    }
+
+    void flush();
+
+   private:
+    OutputStream *stream;
+    const size_t bufferRecords;
+    std::vector<Record> buffer;
+};
+}
@@ -1,37 +1,210 @@
 #include "src_740/coherent_cache_base.hh"
+#include "base/intmath.hh"
 #include "base/trace.hh"
 #include "debug/CCache.hh"
 
+#include <algorithm>
+
 namespace gem5 {
 
 CoherentCacheBase::CoherentCacheBase(const CoherentCacheBaseParams& params)
     : SimObject(params),
       cpuPort(params.name + ".cpu_side", this),
       cacheId(params.cache_id),
-      blocked(false),
-      bus(params.serializing_bus),
-      cpuRespEvent([this](){ processCpuResp(); }, name()) {}
+      buses(params.serializing_bus),
+      tagLatency(params.tag_latency),
+      dataLatency(params.data_latency),
+      responseLatency(params.response_latency),
+      snoopLatency(params.snoop_latency),
+      cpuRespEvent([this](){ processCpuResp(); }, name()),
+      numMshrs(params.mshrs),
+      numTargets(params.tgts_per_mshr),
+      wbBufferSize(params.writeback_buffer_size),
+      stats(this),
+      trace(params.trace) {
+    assoc = params.assoc;
+    fatal_if(assoc == 0, "%s: assoc must be at least 1\n", name());
+
+    blkSize = params.block_size;
+    fatal_if(!isPowerOf2(blkSize),
+             "%s: block size must be a power of 2\n", name());
+    blkBits = floorLog2(blkSize);
+
+    if (params.sets == 0) {
+        numSets = params.size / (assoc * blkSize);
+    } else {
+        numSets = params.sets;
+        fatal_if(numSets * assoc * blkSize != params.size,
+                 "%s: sets * assoc * block_size does not match size\n",
+                 name());
+    }
+    fatal_if(numSets == 0 || !isPowerOf2(numSets),
+             "%s: number of sets must be a power of 2\n", name());
+
+    unsigned numLines = numSets * assoc;
+    tags.assign(numLines, 0);
+    states.assign(numLines, 0);
+    dirty.assign(numLines, 0);
+    pinnedWays.assign(assoc, 0);
+    dataArray.assign(numLines * blkSize, 0);
+    prefetched.assign(numLines, 0);
+    replPolicy = ReplPolicy::create(params.replacement_policy, numSets, assoc);
+    prefetcher = CoherentPrefetcher::create(
+        params.prefetcher, blkSize, params.prefetch_degree,
+        params.prefetch_table_entries, params.prefetch_stride_by_pc);
+    prefetchQueueSize = params.prefetch_queue_size;
+    fatal_if(wbBufferSize == 0,
+             "%s: writeback buffer needs at least one entry\n", name());
+    fatal_if(buses.empty(), "%s: needs at least one bus slice\n", name());
+    fatal_if(numMshrs == 0 || numTargets == 0,
+             "%s: needs at least one MSHR and one target\n", name());
+    mshrs.resize(numMshrs);
+    mshrQueue = RingQueue<Mshr*>(numMshrs, true);
+    for (auto& mshr : mshrs) {
+        mshr.targets = RingQueue<PacketPtr>(numTargets, true);
+        freeMshrs.push_back(&mshr);
+    }
+    busPackets.init(numMshrs, blkSize);
+    prefetchQueue = RingQueue<PrefetchReq>(prefetchQueueSize, true);
 
+    fatal_if(params.cacheable_range_modes.size() >
+             params.cacheable_ranges.size(),
+             "%s: more range modes than cacheable ranges\n", name());
+    for (size_t i = 0; i < params.cacheable_ranges.size(); i++) {
+        const AddrRange &range = params.cacheable_ranges[i];
+        auto mode = i < params.cacheable_range_modes.size()
+            ? params.cacheable_range_modes[i]
+            : enums::CoherentRangeMode::WriteBack;
+        fatal_if(range.interleaved(),
+                 "%s: interleaved cacheable ranges are not supported\n",
+                 name());
+        fatal_if(mode != enums::CoherentRangeMode::Uncached &&
+                 (range.start() % blkSize || range.size() % blkSize),
+                 "%s: cacheable range %s is not block aligned\n",
+                 name(), range.to_string());
+        fatal_if(rangeModes.insert(range, mode) == rangeModes.end(),
+                 "%s: cacheable range %s overlaps another range\n",
+                 name(), range.to_string());
+    }
+}
+
+
+CoherentCacheBase::CoherentCacheStats::CoherentCacheStats(
+    statistics::Group *parent)
+    : statistics::Group(parent),
+      ADD_STAT(readHits, statistics::units::Count::get(),
+               "CPU reads served from a valid line"),
+      ADD_STAT(readMisses, statistics::units::Count::get(),
+               "CPU reads that needed the bus"),
+      ADD_STAT(writeHits, statistics::units::Count::get(),
+               "CPU writes served from a writable line"),
+      ADD_STAT(writeMisses, statistics::units::Count::get(),
+               "CPU writes that needed the bus, including upgrades"),
+      ADD_STAT(missRate, statistics::units::Ratio::get(),
+               "fraction of cacheable CPU accesses that missed",
+               (readMisses + writeMisses) /
+               (readHits + readMisses + writeHits + writeMisses)),
+      ADD_STAT(missLatency, statistics::units::Tick::get(),
+               "ticks from MSHR allocation to the fill"),
+      ADD_STAT(upgrades, statistics::units::Count::get(),
+               "S->M (or O->M) upgrades completed without a data fetch"),
+      ADD_STAT(updates, statistics::units::Count::get(),
+               "writes broadcast to the other holders of a line"),
+      ADD_STAT(snoops, statistics::units::Count::get(),
+               "cacheable snoops received"),
+      ADD_STAT(snoopHits, statistics::units::Count::get(),
+               "snoops that found the line valid"),
+      ADD_STAT(snoopInvalidations, statistics::units::Count::get(),
+               "lines invalidated by another cache's request"),
+      ADD_STAT(backInvalidations, statistics::units::Count::get(),
+               "lines invalidated by the bus snoop filter"),
+      ADD_STAT(dataSupplied, statistics::units::Count::get(),
+               "snooped reads answered with data from this cache"),
+      ADD_STAT(writebacks, statistics::units::Count::get(),
+               "dirty lines written back"),
+      ADD_STAT(wbBufferOccupancy, statistics::units::Count::get(),
+               "average number of entries in the writeback buffer"),
+      ADD_STAT(wbStallTicks, statistics::units::Tick::get(),
+               "ticks CPU requests were stalled on a full writeback buffer"),
+      ADD_STAT(busGrantWait, statistics::units::Tick::get(),
+               "ticks each bus request waited for its grant"),
+      ADD_STAT(prefetchesIssued, statistics::units::Count::get(),
+               "prefetches that took an MSHR and went on the bus"),
+      ADD_STAT(prefetchesUseful, statistics::units::Count::get(),
+               "prefetched lines later found by a demand access"),
+      ADD_STAT(prefetchesLate, statistics::units::Count::get(),
+               "demand accesses that merged into a prefetch in flight"),
+      ADD_STAT(prefetchesUseless, statistics::units::Count::get(),
+               "prefetched lines evicted or invalidated before any use"),
+      ADD_STAT(prefetchesDropped, statistics::units::Count::get(),
+               "suggestions dropped on a full queue or already fetched"),
+      ADD_STAT(prefetchAccuracy, statistics::units::Ratio::get(),
+               "fraction of issued prefetches that a demand access used",
+               (prefetchesUseful + prefetchesLate) / prefetchesIssued),
+      ADD_STAT(prefetchCoverage, statistics::units::Ratio::get(),
+               "fraction of would-be misses found in prefetched lines",
+               prefetchesUseful /
+               (prefetchesUseful + readMisses + writeMisses))
+{
+    missLatency.init(16);
+    busGrantWait.init(16);
+}
 
 void CoherentCacheBase::init() {
+    fatal_if(prefetcher && !canPrefetch(),
+             "%s: this protocol cannot prefetch\n", name());
     DPRINTF(CCache, "C[%d] registering\n\n", cacheId);
-    bus->registerCache(cacheId, this);
+    unsigned wbInFlightMax = 0;
+    for (auto bus : buses) {
+        bus->registerCache(cacheId, this);
+        wbInFlightMax += bus->splitTransaction ? bus->maxOutstanding : 1;
+    }
+
+    // a line has at most one buffered writeback: getting it back takes a
+    // grant, which drains the slice's writebacks first. Write-through
+    // hits are admitted below wbBufferSize, a fill may add a victim and
+    // a write-through per target on top.
+    unsigned wbMax = wbBufferSize + numMshrs * (numTargets + 1) +
+                     numSets * assoc;
+    wbBuffer = RingQueue<PacketPtr>(wbMax, true);
+    wbInFlight = RingQueue<PacketPtr>(wbInFlightMax, true);
+    wbPackets.init(wbMax + wbInFlightMax, blkSize);
 }
 
 void CoherentCacheBase::processCpuResp() {
-    while(!(cpuRespQueue.size() == 0)) {
-        auto first = cpuRespQueue.begin();
-        auto pkt = *first;
-        cpuRespQueue.erase(first);
+    // stop if the CPU refused a response, recvRespRetry resumes
+    while (!cpuRespQueue.empty() && cpuPort.blockedPacket == nullptr &&
+           cpuRespQueue.front().first <= curTick()) {
+        PacketPtr pkt = cpuRespQueue.front().second;
+        cpuRespQueue.pop_front();
         cpuPort.sendPacket(pkt);
         cpuPort.trySendRetry();
     }
+    if (!cpuRespQueue.empty() && cpuPort.blockedPacket == nullptr &&
+        !cpuRespEvent.scheduled()) {
+        schedule(cpuRespEvent, cpuRespQueue.front().first);
+    }
+    checkDrained();
 }
 
 
-void CoherentCacheBase::sendCpuResp(PacketPtr pkt) {
-    cpuRespQueue.push_back(pkt);
-    schedule(cpuRespEvent, curTick()+1);
+void CoherentCacheBase::sendCpuResp(PacketPtr pkt, bool lineAccess) {
+    // an atomic access returns the response to its caller
+    if (atomicActive) {
+        return;
+    }
+    Tick ready = curTick() + responseLatency + busRespDelay;
+    if (lineAccess) {
+        ready += tagLatency + dataLatency;
+    }
+    // never overtake an earlier response
+    if (!cpuRespQueue.empty()) {
+        ready = std::max(ready, cpuRespQueue.back().first);
+    }
+    cpuRespQueue.push_back({ready, pkt});
+    if (!cpuRespEvent.scheduled()) {
+        schedule(cpuRespEvent, ready);
+    }
 }
 
 
@@ -47,55 +220,633 @@ Port& CoherentCacheBase::getPort(const std::string& port_name, PortID idx) {
 }
 
 AddrRangeList CoherentCacheBase::getAddrRanges() const {
-    return bus->getAddrRanges();
+    // all slices front the same memory
+    return buses[0]->getAddrRanges();
 }
 
 void CoherentCacheBase::handleFunctional(PacketPtr pkt) {
-    bus->sendMemReqFunctional(pkt);
+    busFor(pkt->getAddr())->sendMemReqFunctional(pkt);
+}
+
+bool CoherentCacheBase::functionalAccess(PacketPtr pkt) {
+    if ((!pkt->isRead() && !pkt->isWrite()) || !isCacheablePacket(pkt)) {
+        return false;
+    }
+
+    // every valid copy holds the latest data
+    Addr blk = blockAlign(pkt->getAddr());
+    int line = findLine(blk);
+    if (line >= 0 &&
+        pkt->trySatisfyFunctional(nullptr, blk, false, blkSize,
+                                  lineData(line))) {
+        return true;
+    }
+
+    // newest buffered writeback first
+    for (size_t i = wbBuffer.size(); i-- > 0;) {
+        if (wbBuffer[i]->getAddr() == blk &&
+            pkt->trySatisfyFunctional(wbBuffer[i])) {
+            return true;
+        }
+    }
+    return false;
 }
 
 void CoherentCacheBase::sendRangeChange() { cpuPort.sendRangeChange(); }
 
+bool CoherentCacheBase::isCacheable(Addr addr) const {
+    auto it = rangeModes.contains(addr);
+    return it != rangeModes.end() &&
+           it->second != enums::CoherentRangeMode::Uncached;
+}
+
 bool CoherentCacheBase::isCacheablePacket(PacketPtr pkt) {
-    auto addr = pkt->getAddr();
-    return (addr >= 0x8000 && addr < 0x8100);
+    return isCacheable(pkt->getAddr());
+}
+
+bool CoherentCacheBase::isWriteThrough(Addr addr) const {
+    auto it = rangeModes.contains(addr);
+    return it != rangeModes.end() &&
+           it->second == enums::CoherentRangeMode::WriteThrough;
+}
+
+int CoherentCacheBase::findLine(Addr addr) const {
+    addr = blockAlign(addr);
+    unsigned base = setIndex(addr) * assoc;
+    for (unsigned way = 0; way < assoc; way++) {
+        unsigned line = base + way;
+        if (states[line] != 0 && tags[line] == addr) {
+            return line;
+        }
+    }
+    return -1;
+}
+
+int CoherentCacheBase::lookup(Addr addr) {
+    int line = findLine(addr);
+    if (line >= 0) {
+        replPolicy->touch(line);
+    }
+    return line;
+}
+
+int CoherentCacheBase::allocate(Addr addr) {
+    unsigned set = setIndex(addr);
+    unsigned base = set * assoc;
+
+    // prefer an invalid way, otherwise ask the replacement policy
+    int victim = -1;
+    for (unsigned way = 0; way < assoc; way++) {
+        if (states[base + way] == 0) {
+            victim = base + way;
+            break;
+        }
+    }
+    if (victim < 0) {
+        bool anyPinned = false;
+        std::fill(pinnedWays.begin(), pinnedWays.end(), 0);
+        for (Mshr* mshr : mshrQueue) {
+            int line = mshr->busPkt && mshr->busPkt->cmd == MemCmd::WriteReq
+                ? findLine(mshr->blkAddr) : -1;
+            if (line >= 0 && unsigned(line) / assoc == set) {
+                pinnedWays[line - base] = 1;
+                anyPinned = true;
+            }
+        }
+        // grants keep a way free for every fill, see wayAvailable
+        assert(std::find(pinnedWays.begin(), pinnedWays.end(), 0) !=
+               pinnedWays.end());
+        victim = replPolicy->victim(set,
+                                    anyPinned ? pinnedWays.data() : nullptr);
+        evict(victim);
+    }
+
+    tags[victim] = blockAlign(addr);
+    dirty[victim] = 0;
+    replPolicy->insert(victim);
+    busFor(tags[victim])->lineFilled(cacheId, tags[victim]);
+    return victim;
+}
+
+bool CoherentCacheBase::wayAvailable(const Mshr& mshr) const {
+    if (!updateProtocol || mshr.uncacheable) {
+        return true;
+    }
+    unsigned set = setIndex(mshr.blkAddr);
+    unsigned pinned = 0;
+    unsigned fills = 0;
+    for (const Mshr* other : mshrQueue) {
+        if (other->busPkt && !other->uncacheable &&
+            setIndex(other->blkAddr) == set) {
+            if (other->busPkt->cmd == MemCmd::WriteReq) {
+                pinned++;
+            } else if (other->busPkt->cmd != MemCmd::UpgradeReq) {
+                fills++;
+            }
+        }
+    }
+    // a held line is written with an update, which pins it. Fills need a
+    // way only if some may stay pinned until they land.
+    bool pins = isHit(mshr.blkAddr);
+    return (!pins && pinned == 0) || pinned + fills < assoc;
+}
+
+void CoherentCacheBase::retryParked() {
+    for (Mshr* mshr : mshrQueue) {
+        if (mshr->parked && !mshr->issued) {
+            mshr->parked = false;
+            busFor(mshr->blkAddr)->request(cacheId, mshr->allocTick);
+        }
+    }
+}
+
+void CoherentCacheBase::writeback(int line) {
+    // only one cache can hold a line dirty, so writebacks are not snooped
+    if (dirty[line]) {
+        dirty[line] = 0;
+        stats.writebacks++;
+        PacketPtr pkt = wbPackets.acquire(MemCmd::WriteReq, tags[line],
+                                          blkSize, 0, Request::wbRequestorId);
+        pkt->setData(lineData(line));
+
+        SerializingBus* bus = busFor(tags[line]);
+        if (atomicActive || bus->atomicActive) {
+            // off the critical path, the latency is not charged
+            bus->sendWritebackAtomic(pkt);
+            wbPackets.release(pkt);
+            return;
+        }
+
+        wbBuffer.push_back(pkt);
+        stats.wbBufferOccupancy = wbBuffer.size();
+        DPRINTF(CCache, "C[%d] writeback %#x queued, %d in buffer\n\n",
+                cacheId, tags[line], wbBuffer.size());
+        busFor(tags[line])->request(cacheId, curTick());
+    }
+}
+
+int CoherentCacheBase::findWriteback(Addr addr) const {
+    addr = blockAlign(addr);
+    for (size_t i = 0; i < wbBuffer.size(); i++) {
+        if (wbBuffer[i]->getAddr() == addr) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+void CoherentCacheBase::sendWriteback(size_t i) {
+    PacketPtr pkt = wbBuffer[i];
+    wbBuffer.erase(i);
+    wbInFlight.push_back(pkt);
+    stats.wbBufferOccupancy = wbBuffer.size();
+    dropIfGone(pkt->getAddr());
+    if (trace) {
+        uint8_t state = lineState(pkt->getAddr());
+        trace->record(CoherenceTrace::Writeback, cacheId, pkt->getAddr(),
+                      pkt->cmd, state, state);
+    }
+    busFor(pkt->getAddr())->sendWriteback(cacheId, pkt);
+}
+
+void CoherentCacheBase::handleWritebackResp(PacketPtr pkt) {
+    DPRINTF(CCache, "C[%d] writeback %#x done\n\n", cacheId, pkt->getAddr());
+    for (size_t i = 0; i < wbInFlight.size(); i++) {
+        if (wbInFlight[i] == pkt) {
+            wbInFlight.erase(i);
+            break;
+        }
+    }
+    busFor(pkt->getAddr())->release(cacheId);
+    wbPackets.release(pkt);
+
+    maybeUnstallWb();
+    checkDrained();
+}
+
+void CoherentCacheBase::maybeUnstallWb() {
+    if (wbStalled && wbBuffer.size() < wbBufferSize) {
+        wbStalled = false;
+        stats.wbStallTicks += curTick() - wbStallStart;
+        cpuPort.trySendRetry();
+    }
+}
+
+void CoherentCacheBase::snoopWritebacks(PacketPtr pkt) {
+    int i = findWriteback(pkt->getAddr());
+    if (i < 0) {
+        return;
+    }
+
+    if (pkt->isRead() && !pkt->cacheResponding()) {
+        DPRINTF(CCache, "C[%d] supplying %#x from writeback buffer\n\n",
+                cacheId, pkt->getAddr());
+        pkt->setCacheResponding();
+        pkt->setData(wbBuffer[i]->getConstPtr<uint8_t>());
+    }
+
+    if (pkt->needsWritable()) {
+        // the new owner holds the whole block and will write it back
+        // itself, a late write from here could overwrite newer data
+        DPRINTF(CCache, "C[%d] dropping writeback %#x\n\n",
+                cacheId, pkt->getAddr());
+        wbPackets.release(wbBuffer[i]);
+        wbBuffer.erase(i);
+        stats.wbBufferOccupancy = wbBuffer.size();
+        dropIfGone(pkt->getAddr());
+        maybeUnstallWb();
+        checkDrained();
+    } else {
+        // keep the requester from taking the line E and silently
+        // dirtying it before this writeback drains
+        pkt->setHasSharers();
+    }
+}
+
+void CoherentCacheBase::invalidate(int line) {
+    if (prefetched[line]) {
+        prefetched[line] = 0;
+        stats.prefetchesUseless++;
+    }
+    dirty[line] = 0;
+    states[line] = 0;
+    replPolicy->invalidate(line);
+    dropIfGone(tags[line]);
+}
+
+void CoherentCacheBase::countAccess(PacketPtr pkt, bool hit) {
+    if (pkt->isRead()) {
+        (hit ? stats.readHits : stats.readMisses)++;
+    } else {
+        (hit ? stats.writeHits : stats.writeMisses)++;
+    }
+}
+
+void CoherentCacheBase::backInvalidate(Addr blk) {
+    DPRINTF(CCache, "C[%d] back-invalidate %#x\n\n", cacheId, blk);
+    // a buffered writeback of it keeps draining as usual
+    int line = findLine(blk);
+    if (line >= 0) {
+        stats.backInvalidations++;
+        evict(line);
+    }
+}
+
+void CoherentCacheBase::dropIfGone(Addr blk) {
+    blk = blockAlign(blk);
+    if (!isHit(blk) && findWriteback(blk) < 0) {
+        busFor(blk)->lineDropped(cacheId, blk);
+    }
+}
+
+void CoherentCacheBase::evict(int line) {
+    writeback(line);
+    invalidate(line);
+}
+
+void CoherentCacheBase::accessLine(PacketPtr pkt, int line) {
+    panic_if(blockAlign(pkt->getAddr()) !=
+             blockAlign(pkt->getAddr() + pkt->getSize() - 1),
+             "C[%d] access %#x crosses a block boundary\n",
+             cacheId, pkt->getAddr());
+
+    if (pkt->isRead()) {
+        pkt->setDataFromBlock(lineData(line), blkSize);
+    } else {
+        pkt->writeDataToBlock(lineData(line), blkSize);
+        dirty[line] = 1;
+        // write-through ranges keep memory up to date, the line stays
+        // valid but clean
+        if (isWriteThrough(tags[line])) {
+            writeback(line);
+        }
+    }
+    pkt->makeResponse();
+}
+
+bool CoherentCacheBase::supplyData(PacketPtr pkt, int line, bool isOwner) {
+    if (!pkt->isRead() || pkt->cacheResponding() ||
+        (!isOwner && !busFor(tags[line])->forwardClean)) {
+        return false;
+    }
+    DPRINTF(CCache, "C[%d] supplying %#x\n\n", cacheId, tags[line]);
+    stats.dataSupplied++;
+    pkt->setCacheResponding();
+    pkt->setData(lineData(line));
+    return true;
+}
+
+PacketPtr CoherentCacheBase::createBlockPacket(MemCmd cmd, Mshr* mshr) {
+    assert(!mshr->targets.empty() || mshr->prefetch);
+    PacketPtr pkt = mshr->targets.empty()
+        ? busPackets.acquire(cmd, mshr->blkAddr, blkSize,
+                             Request::PREFETCH, mshr->requestor)
+        : busPackets.acquire(cmd, mshr->blkAddr, blkSize, 0,
+                             mshr->targets.front()->req->requestorId());
+    mshr->busPkt = pkt;
+    return pkt;
+}
+
+PacketPtr CoherentCacheBase::createUpdatePacket(Mshr* mshr) {
+    PacketPtr target = mshr->targets.front();
+    assert(target->isWrite() && isHit(mshr->blkAddr));
+    PacketPtr pkt = busPackets.acquire(
+        MemCmd::WriteReq, target->getAddr(), target->getSize(), 0,
+        target->req->requestorId());
+    pkt->setData(target->getConstPtr<uint8_t>());
+    mshr->busPkt = pkt;
+    return pkt;
+}
+
+bool CoherentCacheBase::Mshr::hasWriteTarget() const {
+    for (auto pkt : targets) {
+        if (pkt->isWrite()) {
+            return true;
+        }
+    }
+    return false;
+}
+
+CoherentCacheBase::Mshr* CoherentCacheBase::findMshr(Addr addr) {
+    addr = blockAlign(addr);
+    for (Mshr* mshr : mshrQueue) {
+        if (!mshr->uncacheable && mshr->blkAddr == addr) {
+            return mshr;
+        }
+    }
+    return nullptr;
+}
+
+CoherentCacheBase::Mshr* CoherentCacheBase::claimMshr(Addr blk) {
+    assert(!freeMshrs.empty());
+    Mshr* mshr = freeMshrs.back();
+    freeMshrs.pop_back();
+    assert(mshr->targets.empty());
+    mshr->blkAddr = blk;
+    mshr->uncacheable = false;
+    mshr->issued = false;
+    mshr->writable = false;
+    mshr->allocTick = curTick();
+    mshr->busPkt = nullptr;
+    mshr->prefetch = false;
+    mshr->requestor = 0;
+    mshr->parked = false;
+    mshrQueue.push_back(mshr);
+    return mshr;
+}
+
+CoherentCacheBase::Mshr* CoherentCacheBase::allocateMshr(PacketPtr pkt,
+                                                        bool uncacheable) {
+    Mshr* mshr = claimMshr(uncacheable ? pkt->getAddr()
+                                       : blockAlign(pkt->getAddr()));
+    mshr->uncacheable = uncacheable;
+    mshr->targets.push_back(pkt);
+    DPRINTF(CCache, "C[%d] MSHR for %#x, %d in use\n\n",
+            cacheId, mshr->blkAddr, mshrQueue.size());
+
+    // request bus access
+    // this will lead to handleBusGrant() being called eventually
+    if (!atomicActive) {
+        busFor(mshr->blkAddr)->request(cacheId, mshr->allocTick);
+    }
+    return mshr;
+}
+
+void CoherentCacheBase::freeMshr(Mshr* mshr) {
+    assert(mshr->targets.empty() && mshr->busPkt == nullptr);
+    for (size_t i = 0; i < mshrQueue.size(); i++) {
+        if (mshrQueue[i] == mshr) {
+            mshrQueue.erase(i);
+            break;
+        }
+    }
+    freeMshrs.push_back(mshr);
+    // a prefetch may have waited for a free MSHR
+    if (!prefetchQueue.empty()) {
+        busFor(prefetchQueue.front().blk)->prefetchReady();
+    }
+    cpuPort.trySendRetry();
+    checkDrained();
+}
+
+void CoherentCacheBase::serviceMshr(Mshr* mshr, int line) {
+    if (mshr->prefetch) {
+        prefetched[line] = 1;
+    } else {
+        stats.missLatency.sample(curTick() - mshr->allocTick);
+    }
+    while (!mshr->targets.empty() &&
+           satisfyCpuReq(mshr->targets.front(), line)) {
+        mshr->targets.pop_front();
+    }
+
+    if (mshr->targets.empty()) {
+        freeMshr(mshr);
+    } else {
+        // e.g. a write merged behind a read fill, needs ownership now.
+        // handleAtomic sends it again itself.
+        DPRINTF(CCache, "C[%d] MSHR %#x reissued\n\n",
+                cacheId, mshr->blkAddr);
+        mshr->issued = false;
+        if (!atomicActive) {
+            busFor(mshr->blkAddr)->request(cacheId, mshr->allocTick);
+        }
+        cpuPort.trySendRetry();
+    }
 }
 
 bool CoherentCacheBase::handleRequest(PacketPtr pkt) {
-    if (blocked) {
-        DPRINTF(CCache, "request %#x blocked!\n", pkt->getAddr());
+    if (wbBuffer.size() >= wbBufferSize) {
+        DPRINTF(CCache, "request %#x stalled on writeback buffer!\n",
+                pkt->getAddr());
+        if (!wbStalled) {
+            wbStalled = true;
+            wbStallStart = curTick();
+        }
         return false;
     }
 
     // is packet in cacheable range?
-    if (isCacheablePacket(pkt)) {
-            handleCoherentCpuReq(pkt);
+    bool cacheable = isCacheablePacket(pkt);
+
+    // accesses to a block with an outstanding miss wait behind it in order
+    Mshr* mshr = cacheable ? findMshr(pkt->getAddr()) : nullptr;
+    if (mshr != nullptr) {
+        if (mshr->targets.size() >= numTargets) {
+            DPRINTF(CCache, "request %#x blocked, MSHR targets full!\n",
+                    pkt->getAddr());
+            return false;
+        }
+        DPRINTF(CCache, "C[%d] %#x merged into MSHR\n\n",
+                cacheId, pkt->getAddr());
+        countAccess(pkt, false);
+        if (trace) {
+            uint8_t state = lineState(pkt->getAddr());
+            trace->record(CoherenceTrace::CpuMiss, cacheId, pkt->getAddr(),
+                          pkt->cmd, state, state);
+        }
+        if (mshr->prefetch) {
+            stats.prefetchesLate++;
+            mshr->prefetch = false;
+        }
+        mshr->targets.push_back(pkt);
+        return true;
+    }
+
+    // any other access may need an MSHR, only accept it if one is free
+    if (mshrQueue.size() >= numMshrs) {
+        DPRINTF(CCache, "request %#x blocked, MSHRs full!\n", pkt->getAddr());
+        return false;
+    }
+
+    if (cacheable) {
+        handleCoherentCpuReq(pkt);
     }
     else {
-        blocked = true;
-        requestPacket = pkt;
-        // request the bus
-        bus->request(cacheId);
+        allocateMshr(pkt, true);
     }
 
     return true;
 }
 
 bool CoherentCacheBase::handleResponse(PacketPtr pkt) {
-    assert(blocked);
+    for (PacketPtr wb : wbInFlight) {
+        if (pkt == wb) {
+            handleWritebackResp(pkt);
+            return true;
+        }
+    }
 
-    if (isCacheablePacket(pkt)) {
-        handleCoherentMemResp(pkt);
-    } else {
-        blocked = false;
+    // a split transaction bus can have several MSHRs in flight
+    Mshr* mshr = nullptr;
+    for (Mshr* it : mshrQueue) {
+        if (it->issued && it->busPkt == pkt) {
+            mshr = it;
+            break;
+        }
+    }
+    assert(mshr != nullptr);
+    mshr->busPkt = nullptr;
+    SerializingBus* bus = busFor(mshr->blkAddr);
+    Tick latency = curTick() - mshr->allocTick;
+    busRespDelay = pkt->headerDelay + pkt->payloadDelay;
+    pkt->headerDelay = pkt->payloadDelay = 0;
+
+    if (mshr->uncacheable) {
+        if (trace) {
+            trace->record(CoherenceTrace::Uncacheable, cacheId,
+                          pkt->getAddr(), pkt->cmd, 0, 0, 0, latency);
+        }
+        mshr->targets.pop_front();
+        freeMshr(mshr);
         bus->release(cacheId);
-        cpuPort.sendPacket(pkt);
-        cpuPort.trySendRetry();
+        sendCpuResp(pkt, false);
+    } else if ((pkt->cmd == MemCmd::UpgradeResp ||
+                pkt->cmd == MemCmd::WriteResp) && !isHit(mshr->blkAddr)) {
+        // the S copy was lost while the upgrade waited behind another
+        // transaction to the line, ask for the whole block instead. The
+        // write of a lost update is done again.
+        DPRINTF(CCache, "C[%d] %s %#x lost its line, reissued\n\n",
+                cacheId, pkt->cmdString(), mshr->blkAddr);
+        busPackets.release(pkt);
+        mshr->issued = false;
+        bus->request(cacheId, mshr->allocTick);
+        bus->release(cacheId);
+    } else {
+        if (pkt->cmd == MemCmd::UpgradeResp) {
+            stats.upgrades++;
+        } else if (pkt->cmd == MemCmd::WriteResp) {
+            stats.updates++;
+        }
+        Addr blk = mshr->blkAddr;
+        MemCmd cmd = pkt->cmd;
+        uint8_t before = trace ? lineState(blk) : 0;
+        handleCoherentMemResp(pkt, mshr);
+        if (trace) {
+            trace->record(CoherenceTrace::Fill, cacheId, blk, cmd, before,
+                          lineState(blk), 0, latency);
+        }
     }
+    busRespDelay = 0;
+    retryParked();
 
     return true;
 }
 
+Tick CoherentCacheBase::handleAtomic(PacketPtr pkt) {
+    panic_if(!isIdle(), "C[%d] atomic access with timing requests pending\n",
+             cacheId);
+    // same latencies as the timing path
+    const Tick hitLatency = tagLatency + dataLatency + responseLatency;
+
+    atomicActive = true;
+    bool cacheable = isCacheablePacket(pkt);
+    if (cacheable) {
+        int line = lookup(pkt->getAddr());
+        MemCmd cmd = pkt->cmd;
+        uint8_t before = line >= 0 ? states[line] : 0;
+        if (line >= 0) {
+            prefetchUsed(line);
+        }
+        bool hit = line >= 0 && satisfyCpuReq(pkt, line);
+        countAccess(pkt, hit);
+        if (trace) {
+            trace->record(hit ? CoherenceTrace::CpuHit
+                              : CoherenceTrace::CpuMiss,
+                          cacheId, pkt->getAddr(), cmd, before,
+                          line >= 0 ? states[line] : 0);
+        }
+        if (hit) {
+            atomicActive = false;
+            return hitLatency;
+        }
+    }
+
+    Mshr* mshr = allocateMshr(pkt, !cacheable);
+    mshr->issued = true;
+    SerializingBus* bus = busFor(mshr->blkAddr);
+    bus->beginAtomic(cacheId);
+    if (cacheable) {
+        handleCoherentBusGrant(mshr);
+        // the fill may not be enough for the target, e.g. a Dragon write
+        // that filled the line shared still has to send its update
+        while (!mshrQueue.empty()) {
+            mshr = mshrQueue.front();
+            mshr->issued = true;
+            handleCoherentBusGrant(mshr);
+        }
+    } else {
+        mshr->busPkt = pkt;
+        bus->sendMemReq(pkt, true, true);
+    }
+    Tick latency = bus->endAtomic(cacheId);
+    atomicActive = false;
+
+    assert(mshrQueue.empty());
+    return latency + (cacheable ? hitLatency : responseLatency);
+}
+
+bool CoherentCacheBase::isIdle() const {
+    return mshrQueue.empty() && wbBuffer.empty() && wbInFlight.empty() &&
+           cpuRespQueue.empty() && cpuPort.blockedPacket == nullptr;
+}
+
+void CoherentCacheBase::checkDrained() {
+    if (drainState() == DrainState::Draining && isIdle()) {
+        DPRINTF(CCache, "C[%d] drained\n\n", cacheId);
+        signalDrainDone();
+    }
+}
+
+DrainState CoherentCacheBase::drain() {
+    prefetchQueue.clear();
+    return isIdle() ? DrainState::Drained : DrainState::Draining;
+}
+
+Tick CoherentCacheBase::CpuSidePort::recvAtomic(PacketPtr pkt) {
+    return owner->handleAtomic(pkt);
+}
+
 AddrRangeList CoherentCacheBase::CpuSidePort::getAddrRanges() const {
     return owner->getAddrRanges();
 }
@@ -127,6 +878,7 @@ void CoherentCacheBase::CpuSidePort::recvRespRetry() {
     blockedPacket = nullptr;
 
     sendPacket(pkt);
+    owner->processCpuResp();
 }
 
 void CoherentCacheBase::CpuSidePort::trySendRetry() {
@@ -138,49 +890,207 @@ void CoherentCacheBase::CpuSidePort::trySendRetry() {
 
 void CoherentCacheBase::handleSnoopedReq(PacketPtr pkt) {
     if (isCacheablePacket(pkt)) {
+        stats.snoops++;
+        uint8_t before = lineState(pkt->getAddr());
+        bool wasValid = before != 0;
+        bool responding = pkt->cacheResponding();
+        stats.snoopHits += wasValid;
         handleCoherentSnoopedReq(pkt);
+        snoopWritebacks(pkt);
+        uint8_t after = lineState(pkt->getAddr());
+        stats.snoopInvalidations += wasValid && after == 0;
+        if (trace) {
+            uint8_t result = 0;
+            if (wasValid) {
+                result |= CoherenceTrace::SnoopHit;
+            }
+            if (!responding && pkt->cacheResponding()) {
+                result |= CoherenceTrace::SnoopSupplied;
+            }
+            if (wasValid && after == 0) {
+                result |= CoherenceTrace::SnoopInvalidated;
+            }
+            trace->record(CoherenceTrace::Snoop, cacheId, pkt->getAddr(),
+                          pkt->cmd, before, after, result);
+        }
     }
 }
 
-void CoherentCacheBase::handleBusGrant() {
-    assert(requestPacket != nullptr);
-    assert(cacheId == bus->currentGranted);
+void CoherentCacheBase::handleBusGrant(SerializingBus* slice) {
+    assert(cacheId == slice->currentGranted);
+
+    // writebacks go first, see wbBuffer
+    for (size_t i = 0; i < wbBuffer.size(); i++) {
+        if (busFor(wbBuffer[i]->getAddr()) == slice) {
+            sendWriteback(i);
+            return;
+        }
+    }
+
+    // oldest MSHR still waiting for this slice, demand misses before
+    // prefetches
+    Mshr* mshr = nullptr;
+    Mshr* waiting = nullptr;  // has no way to fill into yet
+    for (Mshr* it : mshrQueue) {
+        if (!it->issued && busFor(it->blkAddr) == slice &&
+            (mshr == nullptr || (mshr->prefetch && !it->prefetch))) {
+            if (wayAvailable(*it)) {
+                mshr = it;
+            } else if (!waiting) {
+                waiting = it;
+            }
+        }
+    }
 
-    if (isCacheablePacket(requestPacket)) {
-        handleCoherentBusGrant();
+    // the request was queued for a writeback that a snoop dropped, or
+    // for an MSHR that has to wait for a response to free a way
+    if (mshr == nullptr) {
+        if (waiting) {
+            DPRINTF(CCache, "C[%d] MSHR %#x waits for a way\n\n",
+                    cacheId, waiting->blkAddr);
+            waiting->parked = true;
+        }
+        slice->release(cacheId);
+        return;
+    }
+
+    mshr->issued = true;
+    mshr->parked = false;
+    if (!mshr->uncacheable) {
+        handleCoherentBusGrant(mshr);
     }
     else {
-        bus->sendMemReq(requestPacket, true);
-        requestPacket = nullptr;
+        mshr->busPkt = mshr->targets.front();
+        slice->sendMemReq(mshr->busPkt, true, true);
+    }
+}
+
+void CoherentCacheBase::notifyPrefetcher(PacketPtr pkt, bool trigger) {
+    prefetchCandidates.clear();
+    prefetcher->notify(pkt->getAddr(), pkt->req->hasPC(),
+                       pkt->req->hasPC() ? pkt->req->getPC() : 0, trigger,
+                       prefetchCandidates);
+
+    for (Addr blk : prefetchCandidates) {
+        if (!isCacheable(blk) || isHit(blk) || findMshr(blk)) {
+            continue;
+        }
+        bool queued = false;
+        for (size_t i = 0; i < prefetchQueue.size() && !queued; i++) {
+            queued = prefetchQueue[i].blk == blk;
+        }
+        if (queued) {
+            continue;
+        }
+        if (prefetchQueue.size() >= prefetchQueueSize) {
+            stats.prefetchesDropped++;
+            continue;
+        }
+        prefetchQueue.push_back({blk, pkt->req->requestorId()});
+        if (prefetchQueue.size() == 1) {
+            busFor(blk)->prefetchReady();
+        }
+    }
+}
+
+bool CoherentCacheBase::prefetchUsed(int line) {
+    if (!prefetched[line]) {
+        return false;
+    }
+    prefetched[line] = 0;
+    stats.prefetchesUseful++;
+    return true;
+}
+
+bool CoherentCacheBase::issuePrefetch(SerializingBus* slice) {
+    if (drainState() != DrainState::Running) {
+        return false;
     }
+    while (!prefetchQueue.empty()) {
+        // the front's slice is told whenever the front changes
+        PrefetchReq next = prefetchQueue.front();
+        if (busFor(next.blk) != slice || mshrQueue.size() + 1 >= numMshrs) {
+            return false;
+        }
+        prefetchQueue.pop_front();
+        if (!prefetchQueue.empty() &&
+            busFor(prefetchQueue.front().blk) != slice) {
+            busFor(prefetchQueue.front().blk)->prefetchReady();
+        }
+
+        // fetched by a demand miss since it was suggested
+        if (isHit(next.blk) || findMshr(next.blk)) {
+            stats.prefetchesDropped++;
+            continue;
+        }
+
+        DPRINTF(CCache, "C[%d] prefetching %#x\n\n", cacheId, next.blk);
+        Mshr* mshr = claimMshr(next.blk);
+        mshr->prefetch = true;
+        mshr->requestor = next.requestor;
+        stats.prefetchesIssued++;
+        slice->request(cacheId, mshr->allocTick);
+        return true;
+    }
+    return false;
+}
+
+bool CoherentCacheBase::satisfyCpuReq(PacketPtr pkt, int line) {
+    return false;
 }
 
 void CoherentCacheBase::handleCoherentCpuReq(PacketPtr pkt) {
     DPRINTF(CCache, "C[%d] cpu req: %s\n\n", cacheId, pkt->print());
-    blocked = true;
+    int line = lookup(pkt->getAddr());
+    MemCmd cmd = pkt->cmd;
+    uint8_t before = line >= 0 ? states[line] : 0;
+    bool wasPrefetched = line >= 0 && prefetchUsed(line);
+
+    // hits are served right away, even while other misses are pending
+    bool hit = line >= 0 && satisfyCpuReq(pkt, line);
+    countAccess(pkt, hit);
+    if (prefetcher) {
+        notifyPrefetcher(pkt, !hit || wasPrefetched);
+    }
+    if (trace) {
+        trace->record(hit ? CoherenceTrace::CpuHit : CoherenceTrace::CpuMiss,
+                      cacheId, pkt->getAddr(), cmd, before,
+                      line >= 0 ? states[line] : 0);
+    }
+    if (hit) {
+        return;
+    }
 
-    // store the packet and request bus access
-    requestPacket = pkt;
-    bus->request(cacheId);
+    DPRINTF(CCache, "C[%d] cache miss %#x\n\n", cacheId, pkt->getAddr());
+    allocateMshr(pkt, false);
 }
 
 
-void CoherentCacheBase::handleCoherentBusGrant() {
+void CoherentCacheBase::handleCoherentBusGrant(Mshr* mshr) {
+    SerializingBus* bus = busFor(mshr->blkAddr);
     DPRINTF(CCache, "C[%d] bus granted\n\n", cacheId);
-    assert(requestPacket != nullptr);
     assert(cacheId == bus->currentGranted);
 
     // bus was granted, send the req to memory.
     // this send is guaranteed to succeed since the bus 
     // belongs to this cache for now
-    bus->sendMemReq(requestPacket, true);
-    requestPacket = nullptr;
+    mshr->busPkt = mshr->targets.front();
+    bus->sendMemReq(mshr->busPkt, true);
 }
 
-void CoherentCacheBase::handleCoherentMemResp(PacketPtr pkt) {
+void CoherentCacheBase::handleCoherentMemResp(PacketPtr pkt, Mshr* mshr) {
+    SerializingBus* bus = busFor(mshr->blkAddr);
     DPRINTF(CCache, "C[%d] mem resp: %s\n\n", cacheId, pkt->print());
-    blocked = false;
+    assert(pkt == mshr->targets.front());
+    mshr->targets.pop_front();
     sendCpuResp(pkt);
+
+    if (mshr->targets.empty()) {
+        freeMshr(mshr);
+    } else {
+        mshr->issued = false;
+        bus->request(cacheId, mshr->allocTick);
+    }
     
     // signal that this cache is done with the bus
     bus->release(cacheId);
@@ -190,4 +1100,81 @@ void CoherentCacheBase::handleCoherentSnoopedReq(PacketPtr pkt) {
     DPRINTF(CCache, "C[%d] snoop: %s\n\n", cacheId, pkt->print());
 }
 
+CoherentCacheBase::Sharing CoherentCacheBase::sharing(int line) const {
+    return states[line] ? Sharing::Shared : Sharing::Invalid;
+}
+
+void CoherentCacheBase::serialize(CheckpointOut& cp) const {
+    panic_if(!isIdle(), "%s: checkpoint with requests in flight\n", name());
+    paramOut(cp, "sets", numSets);
+    paramOut(cp, "assoc", assoc);
+    paramOut(cp, "block_size", blkSize);
+
+    std::vector<uint32_t> lines;
+    std::vector<Addr> lineTags;
+    std::vector<uint8_t> lineStates;
+    std::vector<uint8_t> lineDirty;
+    std::vector<uint8_t> blockData;
+    for (unsigned line = 0; line < states.size(); line++) {
+        if (states[line] == 0) {
+            continue;
+        }
+        lines.push_back(line);
+        lineTags.push_back(tags[line]);
+        lineStates.push_back(states[line]);
+        lineDirty.push_back(dirty[line]);
+        const uint8_t* data = &dataArray[line * blkSize];
+        blockData.insert(blockData.end(), data, data + blkSize);
+    }
+    arrayParamOut(cp, "lines", lines);
+    arrayParamOut(cp, "tags", lineTags);
+    arrayParamOut(cp, "states", lineStates);
+    arrayParamOut(cp, "dirty", lineDirty);
+    arrayParamOut(cp, "data", blockData);
+}
+
+void CoherentCacheBase::unserialize(CheckpointIn& cp) {
+    unsigned cptSets, cptAssoc, cptBlkSize;
+    paramIn(cp, "sets", cptSets);
+    paramIn(cp, "assoc", cptAssoc);
+    paramIn(cp, "block_size", cptBlkSize);
+    fatal_if(cptSets != numSets || cptAssoc != assoc ||
+             cptBlkSize != blkSize,
+             "%s: checkpoint has %d sets x %d ways of %dB, cache has "
+             "%d x %d of %dB\n", name(), cptSets, cptAssoc, cptBlkSize,
+             numSets, assoc, blkSize);
+
+    std::vector<uint32_t> lines;
+    std::vector<Addr> lineTags;
+    std::vector<uint8_t> lineStates;
+    std::vector<uint8_t> lineDirty;
+    std::vector<uint8_t> blockData;
+    arrayParamIn(cp, "lines", lines);
+    arrayParamIn(cp, "tags", lineTags);
+    arrayParamIn(cp, "states", lineStates);
+    arrayParamIn(cp, "dirty", lineDirty);
+    arrayParamIn(cp, "data", blockData);
+    size_t n = lines.size();
+    fatal_if(lineTags.size() != n || lineStates.size() != n ||
+             lineDirty.size() != n || blockData.size() != n * blkSize,
+             "%s: checkpoint line arrays differ in size\n", name());
+
+    for (size_t i = 0; i < n; i++) {
+        unsigned line = lines[i];
+        fatal_if(line >= states.size() || lineStates[i] == 0 ||
+                 setIndex(lineTags[i]) != line / assoc ||
+                 blockAlign(lineTags[i]) != lineTags[i],
+                 "%s: bad checkpoint line %d @ %#x\n", name(), line,
+                 lineTags[i]);
+        tags[line] = lineTags[i];
+        states[line] = lineStates[i];
+        dirty[line] = lineDirty[i];
+        std::copy(&blockData[i * blkSize], &blockData[(i + 1) * blkSize],
+                  lineData(line));
+        replPolicy->insert(line);
+        busFor(tags[line])->lineFilled(cacheId, tags[line]);
+    }
+    DPRINTF(CCache, "C[%d] restored %d lines\n\n", cacheId, n);
+}
+
 }
\ No newline at end of file
@@ -1,12 +1,21 @@
 #pragma once
 
+#include "base/addr_range_map.hh"
+#include "base/statistics.hh"
+#include "enums/CoherentRangeMode.hh"
 #include "mem/port.hh"
 #include "params/CoherentCacheBase.hh"
 #include "sim/sim_object.hh"
 
+#include "src_740/coherence_trace.hh"
+#include "src_740/coherent_prefetcher.hh"
+#include "src_740/packet_pool.hh"
+#include "src_740/replacement_policy.hh"
+#include "src_740/ring_queue.hh"
 #include "src_740/serializing_bus.hh"
 
-#include <list>
+#include <memory>
+#include <vector>
 
 namespace gem5 {
 
@@ -27,7 +36,7 @@ class CoherentCacheBase : public SimObject {
         void sendPacket(PacketPtr pkt);
         void trySendRetry();
 
-        Tick recvAtomic(PacketPtr pkt) override { panic("recvAtomic unimpl."); }
+        Tick recvAtomic(PacketPtr pkt) override;
         void recvFunctional(PacketPtr pkt) override;
         bool recvTimingReq(PacketPtr pkt) override;
         void recvRespRetry() override;
@@ -36,18 +45,159 @@ class CoherentCacheBase : public SimObject {
     CpuSidePort cpuPort;
 
     int cacheId = 0;
-    bool blocked = false;
 
-    // bus connected to other caches and memory
-    SerializingBus* bus;
+    // bus slices connected to other caches and memory. Lines are
+    // interleaved across them by block address, each slice orders only
+    // its own lines.
+    std::vector<SerializingBus*> buses;
+    SerializingBus* busFor(Addr addr) const {
+        return buses[(addr >> blkBits) % buses.size()];
+    }
 
-    // send CPU responses asynchronously
-    std::list<PacketPtr> cpuRespQueue;
+    const Tick tagLatency;
+    const Tick dataLatency;
+    const Tick responseLatency;
+    const Tick snoopLatency;  // the bus waits for its slowest snooper
+
+    // send CPU responses asynchronously and in order, each one when it is
+    // ready. A response that read or wrote a line takes the tag, data and
+    // response latencies, an uncached one only the response latency.
+    // Misses are charged the tag lookup with the fill.
+    RingQueue<std::pair<Tick, PacketPtr>> cpuRespQueue;
     EventFunctionWrapper cpuRespEvent;
     void processCpuResp();
-    void sendCpuResp(PacketPtr pkt);
+    void sendCpuResp(PacketPtr pkt, bool lineAccess = true);
+    // bus transfer of the response being handled, added to the CPU
+    // responses it triggers
+    Tick busRespDelay = 0;
+
+    // miss status holding register: one outstanding block, or one
+    // uncacheable access, and the CPU requests waiting on it in order.
+    // Every MSHR that needs the bus holds one bus request. MSHRs and
+    // their target rings are allocated once, see claimMshr.
+    struct Mshr {
+        Addr blkAddr = 0;
+        bool uncacheable = false;
+        bool issued = false;
+        bool writable = false;  // the issued transaction asked for ownership
+        Tick allocTick = 0;  // age for the bus arbiter, kept on reissue
+        PacketPtr busPkt = nullptr;  // issued request, matches the response
+        RingQueue<PacketPtr> targets;
+        // allocated by the prefetcher with no targets, a demand access
+        // merging into it makes it a regular miss
+        bool prefetch = false;
+        RequestorID requestor = 0;  // of the access that triggered it
+        // a grant passed it over for want of a way, see wayAvailable
+        bool parked = false;
+
+        bool hasWriteTarget() const;
+    };
+
+    unsigned numMshrs;
+    unsigned numTargets;
+    std::vector<Mshr> mshrs;  // numMshrs of them
+    std::vector<Mshr*> freeMshrs;
+    RingQueue<Mshr*> mshrQueue;  // in use, oldest first
+
+    // returns the cacheable MSHR for addr's block, or nullptr
+    Mshr* findMshr(Addr addr);
+    // takes a free MSHR for blk and queues it, without targets
+    Mshr* claimMshr(Addr blk);
+    Mshr* allocateMshr(PacketPtr pkt, bool uncacheable);
+    void freeMshr(Mshr* mshr);
+
+    // the cacheable busPkt of every MSHR, one each
+    PacketPool busPackets;
+
+    // after a fill, responds to the targets in order as long as the line
+    // state allows it. Any targets left over (e.g. writes behind a read
+    // fill to S) re-request the bus.
+    void serviceMshr(Mshr* mshr, int line);
+
+    // set-associative storage shared by all protocols.
+    // line index = set * assoc + way. Tags, states and dirty bits live in
+    // their own arrays, apart from the data, so a set lookup only walks a
+    // few contiguous words even for large caches.
+    unsigned numSets = 1;
+    unsigned assoc = 1;
+    unsigned blkSize = 1;
+    unsigned blkBits = 0;
+    std::vector<Addr> tags;  // block aligned addresses
+    std::vector<uint8_t> states;  // protocol specific, 0 is always Invalid
+    std::vector<uint8_t> dirty;
+    std::vector<uint8_t> dataArray;  // blkSize bytes per line
+    std::unique_ptr<ReplPolicy> replPolicy;
+
+    Addr blockAlign(Addr addr) const { return addr & ~Addr(blkSize - 1); }
+    unsigned setIndex(Addr addr) const {
+        return (addr >> blkBits) & (numSets - 1);
+    }
+    uint8_t* lineData(int line) { return &dataArray[line * blkSize]; }
+
+    // returns the line holding addr, or -1 if it is not present
+    int findLine(Addr addr) const;
+    bool isHit(Addr addr) const { return findLine(addr) >= 0; }
+    uint8_t lineState(Addr addr) const {
+        int line = findLine(addr);
+        return line >= 0 ? states[line] : 0;
+    }
+
+    // findLine for CPU accesses, a hit updates the replacement state
+    int lookup(Addr addr);
+
+    // picks a victim in addr's set, evicts it and claims it for addr.
+    // The returned line is left Invalid, the caller sets its state.
+    // Lines with an update on the bus are never picked: the other
+    // holders hand ownership to this cache when the update reaches them,
+    // so the line must still be here.
+    int allocate(Addr addr);
+    std::vector<uint8_t> pinnedWays;  // per way of the set, reused
+
+    // set by protocols that send updates. Their grants only issue a fill
+    // or an update while the set's ways pinned by updates plus its fills
+    // in flight stay below assoc, so every fill finds a victim. MSHRs
+    // passed over are parked and ask for the bus again once a response
+    // frees a way.
+    bool updateProtocol = false;
+    bool wayAvailable(const Mshr &mshr) const;
+    void retryParked();
+
+    // writes the line back if it is dirty, the line stays valid.
+    // The data is queued in the writeback buffer and drained on the bus.
+    void writeback(int line);
+
+    // drops the line without writing it back, e.g. when ownership of
+    // dirty data moves to another cache
+    void invalidate(int line);
+
+    // writes the line back if it is dirty, then invalidates it
+    void evict(int line);
+
+    // tells the bus once neither a line nor a buffered writeback of blk
+    // is left, a directory stops snooping this cache for it
+    void dropIfGone(Addr blk);
+
+    // the bus snoop filter replaced blk's entry, the line has to go
+    void backInvalidate(Addr blk);
 
-    PacketPtr requestPacket = nullptr;
+    // serves a CPU read/write from a valid line and turns the packet
+    // into a response. Writes mark the line dirty.
+    void accessLine(PacketPtr pkt, int line);
+
+    // answers a snooped read with the line's data instead of memory.
+    // Owners (M/O) always respond, clean holders (E/S) only if the bus
+    // allows forwarding. At most one cache responds. Returns true if this
+    // cache supplied the data.
+    bool supplyData(PacketPtr pkt, int line, bool isOwner);
+
+    // block sized request the cache puts on the bus on behalf of an
+    // MSHR, e.g. a ReadReq fill or a ReadExReq for ownership. It becomes
+    // the MSHR's busPkt.
+    PacketPtr createBlockPacket(MemCmd cmd, Mshr* mshr);
+
+    // update broadcast for the MSHR's first target, a write to a line the
+    // cache holds. A WriteReq with the CPU's data, it becomes the busPkt.
+    PacketPtr createUpdatePacket(Mshr* mshr);
 
     CoherentCacheBase(const CoherentCacheBaseParams &params);
 
@@ -62,18 +212,138 @@ class CoherentCacheBase : public SimObject {
 
     bool handleRequest(PacketPtr pkt);
     bool handleResponse(PacketPtr pkt);
+
+    // atomic mode runs the timing protocol inline: a miss takes one MSHR,
+    // the bus slice is granted at once and memory is accessed atomically.
+    // Responses stay in the packet instead of going through cpuRespQueue
+    // and writebacks go straight to memory. Requires a drained cache.
+    bool atomicActive = false;
+    Tick handleAtomic(PacketPtr pkt);
+
+    // nothing in flight, see drain()
+    bool isIdle() const;
+    void checkDrained();
+    DrainState drain() override;
     void handleFunctional(PacketPtr pkt);
+    // functional access to this cache's copy of the line and its buffered
+    // writebacks. Returns true if a read was satisfied here, writes update
+    // every copy and return false so memory is written as well.
+    bool functionalAccess(PacketPtr pkt);
 
+    // dirty lines waiting for the bus, oldest first. Every entry is
+    // queued with its own bus request; writebacks are drained first on
+    // a grant, so a later miss to the same line reads up to date memory.
+    // Snoop writebacks may push the buffer past wbBufferSize, new CPU
+    // requests are stalled until it drains below it.
+    unsigned wbBufferSize;
+    RingQueue<PacketPtr> wbBuffer;
+    RingQueue<PacketPtr> wbInFlight;  // several on a split transaction bus
+    PacketPool wbPackets;
+    bool wbStalled = false;
+    Tick wbStallStart = 0;
+    // retries a stalled CPU once the buffer has room again
+    void maybeUnstallWb();
+
+    // index of addr's buffered writeback, or -1
+    int findWriteback(Addr addr) const;
+    void sendWriteback(size_t i);
+    void handleWritebackResp(PacketPtr pkt);
+    // buffered lines are owned dirty data: supply it to readers and drop
+    // it when another cache takes ownership
+    void snoopWritebacks(PacketPtr pkt);
+
+    // cacheable ranges and their write policy, looked up on every CPU
+    // request and snoop. Addresses outside all ranges are uncached.
+    AddrRangeMap<enums::CoherentRangeMode> rangeModes;
+
+    bool isCacheable(Addr addr) const;
     bool isCacheablePacket(PacketPtr pkt);
+    bool isWriteThrough(Addr addr) const;
 
-    void handleBusGrant();
+    // slice granted the bus, sends the oldest work that maps to it
+    void handleBusGrant(SerializingBus* slice);
     void handleSnoopedReq(PacketPtr pkt);
 
+    // serves a CPU request from a valid line and responds to it if the
+    // line's state allows it. Returns false if the bus is needed first.
+    virtual bool satisfyCpuReq(PacketPtr pkt, int line);
+
     virtual void handleCoherentCpuReq(PacketPtr pkt);
-    virtual void handleCoherentBusGrant();
-    virtual void handleCoherentMemResp(PacketPtr pkt);
+    virtual void handleCoherentBusGrant(Mshr* mshr);
+    virtual void handleCoherentMemResp(PacketPtr pkt, Mshr* mshr);
     virtual void handleCoherentSnoopedReq(PacketPtr pkt);
 
+    // how a line's state may coexist with copies in other caches, the bus
+    // checks restored checkpoints against it. Invalid for unknown states.
+    // Forward is a clean shared copy that answers reads, at most one.
+    enum class Sharing { Invalid, Shared, Forward, Owned, Exclusive };
+    virtual Sharing sharing(int line) const;
+
+    // only valid lines are saved. Restoring needs the same geometry and
+    // reports the lines to the bus, so a directory or snoop filter is
+    // rebuilt from the caches.
+    void serialize(CheckpointOut &cp) const override;
+    void unserialize(CheckpointIn &cp) override;
+
+    struct CoherentCacheStats : public statistics::Group {
+        CoherentCacheStats(statistics::Group *parent);
+
+        statistics::Scalar readHits;
+        statistics::Scalar readMisses;
+        statistics::Scalar writeHits;
+        statistics::Scalar writeMisses;
+        statistics::Formula missRate;
+        statistics::Histogram missLatency;
+        statistics::Scalar upgrades;
+        statistics::Scalar updates;
+        statistics::Scalar snoops;
+        statistics::Scalar snoopHits;
+        statistics::Scalar snoopInvalidations;
+        statistics::Scalar backInvalidations;
+        statistics::Scalar dataSupplied;
+        statistics::Scalar writebacks;
+        statistics::Average wbBufferOccupancy;
+        statistics::Scalar wbStallTicks;
+        statistics::Histogram busGrantWait;  // sampled by the bus
+        statistics::Scalar prefetchesIssued;
+        statistics::Scalar prefetchesUseful;
+        statistics::Scalar prefetchesLate;
+        statistics::Scalar prefetchesUseless;
+        statistics::Scalar prefetchesDropped;
+        statistics::Formula prefetchAccuracy;
+        statistics::Formula prefetchCoverage;
+    } stats;
+
+    // a cacheable CPU access hit or missed, MSHR merges count as misses
+    void countAccess(PacketPtr pkt, bool hit);
+
+    // optional, every site checks for it before collecting the record
+    CoherenceTrace* trace;
+
+    // optional prefetch engine. Its suggestions wait in prefetchQueue
+    // until a bus slice is idle, then each one takes an MSHR without
+    // targets and a read fill. Fills end up S or E, so a prefetch never
+    // takes ownership from another cache. Prefetches leave the last MSHR
+    // to demand misses and are dropped when the cache drains.
+    struct PrefetchReq {
+        Addr blk;
+        RequestorID requestor;
+    };
+    std::unique_ptr<CoherentPrefetcher> prefetcher;
+    RingQueue<PrefetchReq> prefetchQueue;
+    unsigned prefetchQueueSize;
+    std::vector<Addr> prefetchCandidates;  // reused for every access
+    std::vector<uint8_t> prefetched;  // per line, filled but not used yet
+
+    // MI has no read-only state to prefetch into
+    virtual bool canPrefetch() const { return false; }
+    void notifyPrefetcher(PacketPtr pkt, bool trigger);
+    // a demand access found the line, credits an unused prefetch
+    bool prefetchUsed(int line);
+    // an idle slice asks for work, starts the oldest queued prefetch if
+    // it maps to the slice. Returns true if it requested the slice.
+    bool issuePrefetch(SerializingBus* slice);
+
     virtual ~CoherentCacheBase() {}
 };
 }
\ No newline at end of file
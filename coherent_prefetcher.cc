@@ -0,0 +1,130 @@
+#include "src_740/coherent_prefetcher.hh"
+#include "base/logging.hh"
+
+namespace gem5 {
+
+std::unique_ptr<CoherentPrefetcher> CoherentPrefetcher::create(
+    enums::CoherentPrefetchPolicy type, unsigned blkSize, unsigned degree,
+    unsigned tableEntries, bool strideByPc) {
+    fatal_if(degree == 0, "prefetch degree must be at least 1\n");
+    fatal_if(tableEntries == 0,
+             "prefetch table needs at least one entry\n");
+    switch (type) {
+      case enums::CoherentPrefetchPolicy::Disabled:
+        return nullptr;
+      case enums::CoherentPrefetchPolicy::NextLine:
+        return std::make_unique<NextLinePrefetcher>(blkSize, degree);
+      case enums::CoherentPrefetchPolicy::Stride:
+        return std::make_unique<StridePrefetcher>(blkSize, degree,
+                                                  tableEntries, strideByPc);
+      case enums::CoherentPrefetchPolicy::Stream:
+        return std::make_unique<StreamPrefetcher>(blkSize, degree,
+                                                  tableEntries);
+      default:
+        panic("unknown prefetch policy %d\n", static_cast<int>(type));
+    }
+}
+
+void NextLinePrefetcher::notify(Addr addr, bool hasPc, Addr pc, bool trigger,
+                                std::vector<Addr>& candidates) {
+    if (!trigger) {
+        return;
+    }
+    Addr blk = blockAlign(addr);
+    for (unsigned i = 1; i <= degree; i++) {
+        candidates.push_back(blk + i * blkSize);
+    }
+}
+
+void StridePrefetcher::notify(Addr addr, bool hasPc, Addr pc, bool trigger,
+                              std::vector<Addr>& candidates) {
+    Addr key = byPc && hasPc ? pc : addr >> regionBits;
+    Entry& entry = table[key % table.size()];
+    if (!entry.valid || entry.key != key) {
+        entry = Entry();
+        entry.valid = true;
+        entry.key = key;
+        entry.lastAddr = addr;
+        return;
+    }
+
+    int64_t stride = addr - entry.lastAddr;
+    if (stride == 0) {
+        return;
+    }
+    if (stride == entry.stride) {
+        if (entry.confidence < confident) {
+            entry.confidence++;
+        }
+    } else {
+        // confidence counts how often the stride has been seen
+        entry.stride = stride;
+        entry.confidence = 1;
+    }
+    entry.lastAddr = addr;
+
+    if (entry.confidence < confident) {
+        return;
+    }
+    // small strides land in the same block several times
+    Addr last = blockAlign(addr);
+    for (unsigned i = 1; i <= degree; i++) {
+        Addr blk = blockAlign(addr + i * stride);
+        if (blk != last) {
+            candidates.push_back(blk);
+            last = blk;
+        }
+    }
+}
+
+void StreamPrefetcher::notify(Addr addr, bool hasPc, Addr pc, bool trigger,
+                              std::vector<Addr>& candidates) {
+    if (!trigger) {
+        return;
+    }
+    Addr blk = blockAlign(addr);
+    useCount++;
+
+    Stream* victim = &streams[0];
+    for (auto& stream : streams) {
+        if (!stream.valid) {
+            victim = &stream;
+            continue;
+        }
+        Addr distance = blk > stream.lastBlk ? blk - stream.lastBlk
+                                             : stream.lastBlk - blk;
+        if (distance == 0 || distance > window * blkSize) {
+            if (victim->valid && stream.lastUse < victim->lastUse) {
+                victim = &stream;
+            }
+            continue;
+        }
+
+        int dir = blk > stream.lastBlk ? 1 : -1;
+        if (dir == stream.dir) {
+            if (stream.confidence < confident) {
+                stream.confidence++;
+            }
+        } else {
+            stream.dir = dir;
+            stream.confidence = 1;
+        }
+        stream.lastBlk = blk;
+        stream.lastUse = useCount;
+
+        if (stream.confidence >= confident) {
+            for (unsigned i = 1; i <= degree; i++) {
+                Addr offset = Addr(i) * blkSize;
+                candidates.push_back(dir > 0 ? blk + offset : blk - offset);
+            }
+        }
+        return;
+    }
+
+    *victim = Stream();
+    victim->valid = true;
+    victim->lastBlk = blk;
+    victim->lastUse = useCount;
+}
+
+}
@@ -0,0 +1,101 @@
+#pragma once
+
+#include "base/types.hh"
+#include "enums/CoherentPrefetchPolicy.hh"
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace gem5 {
+
+// Suggests blocks for CoherentCacheBase to prefetch. The cache reports
+// every demand access, trigger is set for misses and for the first use
+// of a prefetched line. The cache drops suggestions it already holds or
+// is fetching, so a prefetcher may repeat itself.
+class CoherentPrefetcher {
+   public:
+    CoherentPrefetcher(unsigned blkSize, unsigned degree)
+        : blkSize(blkSize), degree(degree) {}
+    virtual ~CoherentPrefetcher() {}
+
+    // appends block addresses to candidates
+    virtual void notify(Addr addr, bool hasPc, Addr pc, bool trigger,
+                        std::vector<Addr> &candidates) = 0;
+
+    // tableEntries sizes the stride table or the number of streams
+    static std::unique_ptr<CoherentPrefetcher> create(
+        enums::CoherentPrefetchPolicy type, unsigned blkSize,
+        unsigned degree, unsigned tableEntries, bool strideByPc);
+
+   protected:
+    const unsigned blkSize;
+    const unsigned degree;  // blocks suggested per trigger
+
+    Addr blockAlign(Addr addr) const { return addr & ~Addr(blkSize - 1); }
+};
+
+// the degree blocks after a triggering access
+class NextLinePrefetcher : public CoherentPrefetcher {
+   public:
+    using CoherentPrefetcher::CoherentPrefetcher;
+
+    void notify(Addr addr, bool hasPc, Addr pc, bool trigger,
+                std::vector<Addr> &candidates) override;
+};
+
+// learns the distance between consecutive accesses of the same load or
+// store (PC), or to the same 4kB region without a PC. After the same
+// stride is seen twice it fetches degree strides ahead on every access.
+class StridePrefetcher : public CoherentPrefetcher {
+   public:
+    StridePrefetcher(unsigned blkSize, unsigned degree, unsigned entries,
+                     bool byPc)
+        : CoherentPrefetcher(blkSize, degree), table(entries), byPc(byPc) {}
+
+    void notify(Addr addr, bool hasPc, Addr pc, bool trigger,
+                std::vector<Addr> &candidates) override;
+
+   private:
+    static const unsigned regionBits = 12;
+    static const uint8_t confident = 2;
+
+    struct Entry {
+        bool valid = false;
+        Addr key = 0;
+        Addr lastAddr = 0;
+        int64_t stride = 0;
+        uint8_t confidence = 0;
+    };
+    std::vector<Entry> table;  // direct mapped
+    const bool byPc;
+};
+
+// follows ascending or descending runs of triggering blocks. A trigger
+// close behind a tracked stream advances it, two steps the same way
+// confirm the direction, and from then on every trigger fetches the
+// degree blocks ahead of it. Unmatched triggers replace the least
+// recently advanced stream.
+class StreamPrefetcher : public CoherentPrefetcher {
+   public:
+    StreamPrefetcher(unsigned blkSize, unsigned degree, unsigned entries)
+        : CoherentPrefetcher(blkSize, degree), streams(entries) {}
+
+    void notify(Addr addr, bool hasPc, Addr pc, bool trigger,
+                std::vector<Addr> &candidates) override;
+
+   private:
+    static const unsigned window = 4;  // blocks
+    static const uint8_t confident = 2;
+
+    struct Stream {
+        bool valid = false;
+        Addr lastBlk = 0;
+        int dir = 0;  // +1 ascending, -1 descending
+        uint8_t confidence = 0;
+        uint64_t lastUse = 0;
+    };
+    std::vector<Stream> streams;
+    uint64_t useCount = 0;
+};
+}
@@ -0,0 +1,72 @@
+#!/usr/bin/env python3
+# Prints a binary trace written by CoherenceTrace, one record per line.
+# Line states are the protocol's own numbers, 0 is always Invalid.
+
+import argparse
+import struct
+import sys
+
+HEADER = struct.Struct('<8sIIII')
+RECORD = struct.Struct('<QQIhBBBBB5x')
+
+EVENTS = ['CpuHit', 'CpuMiss', 'Fill', 'Uncacheable', 'Snoop', 'Writeback',
+          'Transaction']
+SNOOP_BITS = [(1, 'hit'), (2, 'supplied'), (4, 'invalidated')]
+
+
+def read_header(f):
+    magic, version, record_size, num_cmds, _ = HEADER.unpack(
+        f.read(HEADER.size))
+    if magic != b'CCTRACE\0' or version != 1:
+        sys.exit('not a coherence trace, or an unknown version')
+    if record_size != RECORD.size:
+        sys.exit('unexpected record size %d' % record_size)
+
+    cmds = []
+    name = b''
+    while len(cmds) < num_cmds:
+        c = f.read(1)
+        if not c:
+            sys.exit('truncated command table')
+        if c == b'\0':
+            cmds.append(name.decode())
+            name = b''
+        else:
+            name += c
+    return cmds
+
+
+def records(f):
+    while True:
+        data = f.read(RECORD.size)
+        if len(data) < RECORD.size:
+            return
+        yield RECORD.unpack(data)
+
+
+def main():
+    parser = argparse.ArgumentParser(
+        description='print a binary coherence trace')
+    parser.add_argument('trace', help='trace file, e.g. m5out/coherence.trace')
+    parser.add_argument('--cache', type=int, help='only this cache id')
+    parser.add_argument('--addr', type=lambda x: int(x, 0),
+                        help='only this address')
+    args = parser.parse_args()
+
+    with open(args.trace, 'rb') as f:
+        cmds = read_header(f)
+        for (tick, addr, latency, cache_id, event, cmd, before, after,
+             snoop) in records(f):
+            if args.cache is not None and cache_id != args.cache:
+                continue
+            if args.addr is not None and addr != args.addr:
+                continue
+            result = ','.join(n for bit, n in SNOOP_BITS if snoop & bit)
+            print('%d: C[%d] %-11s %-14s %#x %d->%d %s lat=%d' % (
+                tick, cache_id, EVENTS[event] if event < len(EVENTS)
+                else event, cmds[cmd] if cmd < len(cmds) else cmd, addr,
+                before, after, result or '-', latency))
+
+
+if __name__ == '__main__':
+    main()
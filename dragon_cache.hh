@@ -0,0 +1,71 @@
+#pragma once
+
+#include "params/DragonCache.hh"
+
+#include "src_740/protocol_cache.hh"
+
+namespace gem5 {
+
+// Update protocol for producer/consumer sharing. A write to a shared line
+// broadcasts the written bytes, the other holders update their copy in
+// place instead of dropping it, so readers keep hitting. The last writer
+// owns the line (Sm, or M once nobody else holds it) and writes it back.
+// Write misses read the block first, there are no invalidations.
+struct DragonProtocol {
+    enum State : uint8_t { I, M, Sm, E, Sc, NumStates };
+
+    static constexpr const char *name = "dragon";
+    static constexpr const char *stateNames[NumStates] = {"I", "M", "Sm",
+                                                          "E", "Sc"};
+    static constexpr CoherentCacheBase::Sharing sharing[NumStates] = {
+        CoherentCacheBase::Sharing::Invalid,
+        CoherentCacheBase::Sharing::Exclusive,
+        CoherentCacheBase::Sharing::Owned,
+        CoherentCacheBase::Sharing::Exclusive,
+        CoherentCacheBase::Sharing::Shared};
+
+    static constexpr ProtocolTable<NumStates> makeTable() {
+        using namespace ProtocolAction;
+        ProtocolTable<NumStates> t;
+        t.on(I, GrantRead, I, SendRead);
+        t.on(I, GrantWrite, I, SendRead);
+        t.on(I, FillShared, Sc);
+        t.on(I, FillExclusive, E);
+
+        t.on(M, CpuRead, M, Hit);
+        t.on(M, CpuWrite, M, Hit);
+        t.on(M, SnoopRead, Sm, SetSharers | SupplyOwned);
+
+        t.on(Sm, CpuRead, Sm, Hit);
+        t.on(Sm, CpuWrite, Sm);
+        t.on(Sm, GrantWrite, Sm, SendUpdate);
+        t.on(Sm, UpdateShared, Sm);
+        t.on(Sm, UpdateAlone, M);
+        t.on(Sm, SnoopRead, Sm, SetSharers | SupplyOwned);
+        t.on(Sm, SnoopUpdate, Sc, SetSharers | UpdateData);
+
+        t.on(E, CpuRead, E, Hit);
+        t.on(E, CpuWrite, M, Hit | SilentUpgrade);
+        t.on(E, SnoopRead, Sc, SetSharers | SupplyClean);
+
+        t.on(Sc, CpuRead, Sc, Hit);
+        t.on(Sc, CpuWrite, Sc);
+        t.on(Sc, GrantWrite, Sc, SendUpdate);
+        t.on(Sc, UpdateShared, Sm);
+        t.on(Sc, UpdateAlone, M);
+        t.on(Sc, SnoopRead, Sc, SetSharers | SupplyClean);
+        t.on(Sc, SnoopUpdate, Sc, SetSharers | UpdateData);
+        return t;
+    }
+    static const ProtocolTable<NumStates> table;
+};
+inline constexpr ProtocolTable<DragonProtocol::NumStates>
+    DragonProtocol::table = DragonProtocol::makeTable();
+
+extern template class ProtocolCache<DragonProtocol>;
+
+class DragonCache : public ProtocolCache<DragonProtocol> {
+   public:
+    DragonCache(const DragonCacheParams &params) : ProtocolCache(params) {}
+};
+}
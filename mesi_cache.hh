@@ -1,42 +1,63 @@
 #pragma once
 
-#include "mem/port.hh"
 #include "params/MesiCache.hh"
-#include "sim/sim_object.hh"
 
-#include "coherent_cache_base.hh"
-#include "src_740/serializing_bus.hh"
-
-#include <list>
+#include "src_740/protocol_cache.hh"
 
 namespace gem5 {
 
-class MesiCache : public CoherentCacheBase {
+// MSI plus Exclusive: a read no other cache shares fills in E, which
+// becomes M on a write without the bus.
+struct MesiProtocol {
+    enum State : uint8_t { I, M, E, S, NumStates };
+
+    static constexpr const char *name = "mesi";
+    static constexpr const char *stateNames[NumStates] = {"I", "M", "E",
+                                                          "S"};
+    static constexpr CoherentCacheBase::Sharing sharing[NumStates] = {
+        CoherentCacheBase::Sharing::Invalid,
+        CoherentCacheBase::Sharing::Exclusive,
+        CoherentCacheBase::Sharing::Exclusive,
+        CoherentCacheBase::Sharing::Shared};
+
+    static constexpr ProtocolTable<NumStates> makeTable() {
+        using namespace ProtocolAction;
+        ProtocolTable<NumStates> t;
+        t.on(I, GrantRead, I, SendRead);
+        t.on(I, GrantWrite, I, SendReadEx);
+        t.on(I, FillShared, S);
+        t.on(I, FillExclusive, E);
+        t.on(I, FillWritable, M, TakeDirty);
+
+        t.on(M, CpuRead, M, Hit);
+        t.on(M, CpuWrite, M, Hit);
+        // no O state, memory must be up to date before sharing
+        t.on(M, SnoopRead, S, SetSharers | SupplyOwned | Writeback);
+        t.on(M, SnoopWrite, I, SupplyOwned | WritebackUnlessSupplied |
+                               Invalidate);
+
+        t.on(E, CpuRead, E, Hit);
+        t.on(E, CpuWrite, M, Hit | SilentUpgrade);
+        t.on(E, SnoopRead, S, SetSharers | SupplyClean);
+        t.on(E, SnoopWrite, I, SupplyClean | Invalidate);
+
+        t.on(S, CpuRead, S, Hit);
+        t.on(S, CpuWrite, S);
+        t.on(S, GrantWrite, S, SendUpgrade);
+        t.on(S, FillUpgrade, M);
+        t.on(S, SnoopRead, S, SetSharers | SupplyClean);
+        t.on(S, SnoopWrite, I, SupplyClean | Invalidate);
+        return t;
+    }
+    static const ProtocolTable<NumStates> table;
+};
+inline constexpr ProtocolTable<MesiProtocol::NumStates> MesiProtocol::table =
+    MesiProtocol::makeTable();
+
+extern template class ProtocolCache<MesiProtocol>;
+
+class MesiCache : public ProtocolCache<MesiProtocol> {
    public:
-    MesiCache(const MesiCacheParams &params);
-
-    // coherence state machine, data storage etc. here
-    enum class MesiState {
-        Modified,
-        Exclusive,
-        Shared,
-        Invalid,
-        Error
-    } state = MesiState::Invalid;
-    
-    unsigned char data = 0;
-    long tag = 0;
-    bool dirty = false;
-
-    unsigned char dataToWrite = 0;
-
-    bool isHit(long addr);
-    void allocate(long addr);
-    void evict();
-
-    void handleCoherentCpuReq(PacketPtr pkt) override;
-    void handleCoherentBusGrant() override;
-    void handleCoherentMemResp(PacketPtr pkt) override;
-    void handleCoherentSnoopedReq(PacketPtr pkt) override;
+    MesiCache(const MesiCacheParams &params) : ProtocolCache(params) {}
 };
-}
\ No newline at end of file
+}
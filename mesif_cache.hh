@@ -0,0 +1,76 @@
+#pragma once
+
+#include "params/MesifCache.hh"
+
+#include "src_740/protocol_cache.hh"
+
+namespace gem5 {
+
+// MESI plus Forward: of the caches sharing a clean line exactly one holds
+// it in F and answers reads with the data, so read-mostly lines rarely
+// go to memory. F moves to the newest reader, the old holder keeps an S
+// copy. M answers reads too and hands F over the same way, E and S only
+// supply data if the bus allows clean forwarding (forward_clean).
+struct MesifProtocol {
+    enum State : uint8_t { I, M, E, S, F, NumStates };
+
+    static constexpr const char *name = "mesif";
+    static constexpr const char *stateNames[NumStates] = {"I", "M", "E",
+                                                          "S", "F"};
+    static constexpr CoherentCacheBase::Sharing sharing[NumStates] = {
+        CoherentCacheBase::Sharing::Invalid,
+        CoherentCacheBase::Sharing::Exclusive,
+        CoherentCacheBase::Sharing::Exclusive,
+        CoherentCacheBase::Sharing::Shared,
+        CoherentCacheBase::Sharing::Forward};
+
+    static constexpr ProtocolTable<NumStates> makeTable() {
+        using namespace ProtocolAction;
+        ProtocolTable<NumStates> t;
+        t.on(I, GrantRead, I, SendRead);
+        t.on(I, GrantWrite, I, SendReadEx);
+        // the newest reader of a shared line forwards it from now on
+        t.on(I, FillShared, F);
+        t.on(I, FillExclusive, E);
+        t.on(I, FillWritable, M, TakeDirty);
+
+        t.on(M, CpuRead, M, Hit);
+        t.on(M, CpuWrite, M, Hit);
+        // no O state, memory must be up to date before sharing
+        t.on(M, SnoopRead, S, SetSharers | SupplyOwned | Writeback);
+        t.on(M, SnoopWrite, I, SupplyOwned | WritebackUnlessSupplied |
+                               Invalidate);
+
+        t.on(E, CpuRead, E, Hit);
+        t.on(E, CpuWrite, M, Hit | SilentUpgrade);
+        t.on(E, SnoopRead, S, SetSharers | SupplyClean);
+        t.on(E, SnoopWrite, I, SupplyClean | Invalidate);
+
+        // S leaves reads to the F copy, or to memory once F is evicted
+        t.on(S, CpuRead, S, Hit);
+        t.on(S, CpuWrite, S);
+        t.on(S, GrantWrite, S, SendUpgrade);
+        t.on(S, FillUpgrade, M);
+        t.on(S, SnoopRead, S, SetSharers);
+        t.on(S, SnoopWrite, I, SupplyClean | Invalidate);
+
+        t.on(F, CpuRead, F, Hit);
+        t.on(F, CpuWrite, F);
+        t.on(F, GrantWrite, F, SendUpgrade);
+        t.on(F, FillUpgrade, M);
+        t.on(F, SnoopRead, S, SetSharers | SupplyOwned);
+        t.on(F, SnoopWrite, I, SupplyOwned | Invalidate);
+        return t;
+    }
+    static const ProtocolTable<NumStates> table;
+};
+inline constexpr ProtocolTable<MesifProtocol::NumStates>
+    MesifProtocol::table = MesifProtocol::makeTable();
+
+extern template class ProtocolCache<MesifProtocol>;
+
+class MesifCache : public ProtocolCache<MesifProtocol> {
+   public:
+    MesifCache(const MesifCacheParams &params) : ProtocolCache(params) {}
+};
+}
@@ -1,51 +1,45 @@
 #pragma once
 
-#include "mem/port.hh"
 #include "params/MiCache.hh"
-#include "sim/sim_object.hh"
 
-#include "coherent_cache_base.hh"
-#include "src_740/serializing_bus.hh"
-
-#include <list>
+#include "src_740/protocol_cache.hh"
 
 namespace gem5 {
 
-class MiCache : public CoherentCacheBase {
+// Modified is the only valid state, so reads and writes alike fetch the
+// whole block for ownership. Other caches hand their copy over and drop
+// it.
+struct MiProtocol {
+    enum State : uint8_t { I, M, NumStates };
+
+    static constexpr const char *name = "mi";
+    static constexpr const char *stateNames[NumStates] = {"I", "M"};
+    static constexpr CoherentCacheBase::Sharing sharing[NumStates] = {
+        CoherentCacheBase::Sharing::Invalid,
+        CoherentCacheBase::Sharing::Exclusive};
+
+    static constexpr ProtocolTable<NumStates> makeTable() {
+        using namespace ProtocolAction;
+        ProtocolTable<NumStates> t;
+        t.on(I, GrantRead, I, SendReadEx);
+        t.on(I, GrantWrite, I, SendReadEx);
+        t.on(I, FillWritable, M, TakeDirty);
+
+        t.on(M, CpuRead, M, Hit);
+        t.on(M, CpuWrite, M, Hit);
+        t.on(M, SnoopWrite, I, SupplyOwned | WritebackUnlessSupplied |
+                               Invalidate);
+        return t;
+    }
+    static const ProtocolTable<NumStates> table;
+};
+inline constexpr ProtocolTable<MiProtocol::NumStates> MiProtocol::table =
+    MiProtocol::makeTable();
+
+extern template class ProtocolCache<MiProtocol>;
+
+class MiCache : public ProtocolCache<MiProtocol> {
    public:
-    MiCache(const MiCacheParams &params);
-
-    // only one entry in cache, only one state variable needed
-    enum class MiState {
-        Invalid,
-        Modified,
-        Error
-    } state = MiState::Invalid;
-
-    // single entry cache = all bits are used for tag
-    unsigned char data = 0;
-    long tag = 0;
-    bool dirty = false;
-
-    unsigned char dataToWrite = 0;
-
-    bool isHit(long addr);
-    void allocate(long addr);
-    void evict();
-    
-    // executed when the CPU sends a read/write request packet to this cache
-    // @param pkt: the request packet
-    void handleCoherentCpuReq(PacketPtr pkt) override;
-
-    // executed when the bus grants access to this cache
-    void handleCoherentBusGrant() override;
-
-    // executed when the cache receives a response from the memory
-    // @param pkt: the response packet
-    void handleCoherentMemResp(PacketPtr pkt) override;
-
-    // executed when the cache snoops a request on the shared bus
-    // @param pkt: the snooped packet
-    void handleCoherentSnoopedReq(PacketPtr pkt) override;
+    MiCache(const MiCacheParams &params) : ProtocolCache(params) {}
 };
-}
\ No newline at end of file
+}
@@ -0,0 +1,7 @@
+#include "src_740/moesi_cache.hh"
+
+namespace gem5 {
+
+template class ProtocolCache<MoesiProtocol>;
+
+}
@@ -0,0 +1,73 @@
+#pragma once
+
+#include "params/MoesiCache.hh"
+
+#include "src_740/protocol_cache.hh"
+
+namespace gem5 {
+
+// MESI plus Owned: a dirty line that was read by another cache. The
+// owner supplies the data on snoops and is the only cache that writes it
+// back.
+struct MoesiProtocol {
+    enum State : uint8_t { I, M, O, E, S, NumStates };
+
+    static constexpr const char *name = "moesi";
+    static constexpr const char *stateNames[NumStates] = {"I", "M", "O",
+                                                          "E", "S"};
+    static constexpr CoherentCacheBase::Sharing sharing[NumStates] = {
+        CoherentCacheBase::Sharing::Invalid,
+        CoherentCacheBase::Sharing::Exclusive,
+        CoherentCacheBase::Sharing::Owned,
+        CoherentCacheBase::Sharing::Exclusive,
+        CoherentCacheBase::Sharing::Shared};
+
+    static constexpr ProtocolTable<NumStates> makeTable() {
+        using namespace ProtocolAction;
+        ProtocolTable<NumStates> t;
+        t.on(I, GrantRead, I, SendRead);
+        t.on(I, GrantWrite, I, SendReadEx);
+        // data from an owner is clean here, the owner keeps writing it back
+        t.on(I, FillShared, S);
+        t.on(I, FillExclusive, E);
+        t.on(I, FillWritable, M, TakeDirty);
+
+        // the requester of a ReadEx becomes M and takes over dirty data,
+        // so every write snoop drops the line without a writeback
+        t.on(M, CpuRead, M, Hit);
+        t.on(M, CpuWrite, M, Hit);
+        t.on(M, SnoopRead, O, SetSharers | SupplyOwned);
+        t.on(M, SnoopWrite, I, SupplyOwned | Invalidate);
+
+        t.on(O, CpuRead, O, Hit);
+        t.on(O, CpuWrite, O);
+        t.on(O, GrantWrite, O, SendUpgrade);
+        t.on(O, FillUpgrade, M);
+        t.on(O, SnoopRead, O, SetSharers | SupplyOwned);
+        t.on(O, SnoopWrite, I, SupplyOwned | Invalidate);
+
+        t.on(E, CpuRead, E, Hit);
+        t.on(E, CpuWrite, M, Hit | SilentUpgrade);
+        t.on(E, SnoopRead, S, SetSharers | SupplyClean);
+        t.on(E, SnoopWrite, I, SupplyClean | Invalidate);
+
+        t.on(S, CpuRead, S, Hit);
+        t.on(S, CpuWrite, S);
+        t.on(S, GrantWrite, S, SendUpgrade);
+        t.on(S, FillUpgrade, M);
+        t.on(S, SnoopRead, S, SetSharers | SupplyClean);
+        t.on(S, SnoopWrite, I, SupplyClean | Invalidate);
+        return t;
+    }
+    static const ProtocolTable<NumStates> table;
+};
+inline constexpr ProtocolTable<MoesiProtocol::NumStates>
+    MoesiProtocol::table = MoesiProtocol::makeTable();
+
+extern template class ProtocolCache<MoesiProtocol>;
+
+class MoesiCache : public ProtocolCache<MoesiProtocol> {
+   public:
+    MoesiCache(const MoesiCacheParams &params) : ProtocolCache(params) {}
+};
+}
@@ -1,42 +1,56 @@
 #pragma once
 
-#include "mem/port.hh"
 #include "params/MsiCache.hh"
-#include "sim/sim_object.hh"
 
-#include "coherent_cache_base.hh"
-#include "src_740/serializing_bus.hh"
-
-#include <list>
+#include "src_740/protocol_cache.hh"
 
 namespace gem5 {
 
-class MsiCache : public CoherentCacheBase {
+// Reads fill in Shared, writes need Modified. A write to S keeps the
+// data and upgrades, a dirty line snooped by a read is written back and
+// dropped.
+struct MsiProtocol {
+    enum State : uint8_t { I, M, S, NumStates };
+
+    static constexpr const char *name = "msi";
+    static constexpr const char *stateNames[NumStates] = {"I", "M", "S"};
+    static constexpr CoherentCacheBase::Sharing sharing[NumStates] = {
+        CoherentCacheBase::Sharing::Invalid,
+        CoherentCacheBase::Sharing::Exclusive,
+        CoherentCacheBase::Sharing::Shared};
+
+    static constexpr ProtocolTable<NumStates> makeTable() {
+        using namespace ProtocolAction;
+        ProtocolTable<NumStates> t;
+        t.on(I, GrantRead, I, SendRead);
+        t.on(I, GrantWrite, I, SendReadEx);
+        t.on(I, FillShared, S);
+        t.on(I, FillExclusive, S);
+        t.on(I, FillWritable, M, TakeDirty);
+
+        t.on(M, CpuRead, M, Hit);
+        t.on(M, CpuWrite, M, Hit);
+        t.on(M, SnoopRead, I, SupplyOwned | Writeback | Invalidate);
+        t.on(M, SnoopWrite, I, SupplyOwned | WritebackUnlessSupplied |
+                               Invalidate);
+
+        t.on(S, CpuRead, S, Hit);
+        t.on(S, CpuWrite, S);
+        t.on(S, GrantWrite, S, SendUpgrade);
+        t.on(S, FillUpgrade, M);
+        t.on(S, SnoopRead, S, SupplyClean);
+        t.on(S, SnoopWrite, I, SupplyClean | Invalidate);
+        return t;
+    }
+    static const ProtocolTable<NumStates> table;
+};
+inline constexpr ProtocolTable<MsiProtocol::NumStates> MsiProtocol::table =
+    MsiProtocol::makeTable();
+
+extern template class ProtocolCache<MsiProtocol>;
+
+class MsiCache : public ProtocolCache<MsiProtocol> {
    public:
-    MsiCache(const MsiCacheParams &params);
-
-    // your cache storage, state machine etc here. See MiCache for reference.
-    // MSI has 3 valid states
-    enum class MsiState {
-        Modified,
-        Shared,
-        Invalid,
-        Error
-    } state = MsiState::Invalid;
-
-    unsigned char data = 0;
-    long tag = 0;
-    bool dirty = false;
-
-    unsigned char dataToWrite = 0;
-
-    bool isHit(long addr);
-    void allocate(long addr);
-    void evict();
-    
-    void handleCoherentCpuReq(PacketPtr pkt) override;
-    void handleCoherentBusGrant() override;
-    void handleCoherentMemResp(PacketPtr pkt) override;
-    void handleCoherentSnoopedReq(PacketPtr pkt) override;
+    MsiCache(const MsiCacheParams &params) : ProtocolCache(params) {}
 };
 }
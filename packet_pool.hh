@@ -0,0 +1,86 @@
+#pragma once
+
+#include "mem/packet.hh"
+#include "mem/request.hh"
+
+#include <cassert>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <vector>
+
+namespace gem5 {
+
+// Packets a cache builds for the bus, e.g. fills, updates and
+// writebacks. Every slot owns a Packet's storage, a Request and a block
+// of data, acquire() builds the packet in place over them. The owner
+// sizes the pool from its params, running out is a bug.
+class PacketPool {
+   public:
+    void init(size_t capacity, unsigned blkSize) {
+        assert(live.empty());
+        this->blkSize = blkSize;
+        storage.resize(capacity);
+        reqs.resize(capacity);
+        data.assign(capacity * blkSize, 0);
+        live.assign(capacity, 0);
+        freeSlots.clear();
+        for (size_t i = capacity; i-- > 0;) {
+            freeSlots.push_back(i);
+        }
+    }
+
+    ~PacketPool() {
+        for (size_t i = 0; i < live.size(); i++) {
+            if (live[i]) {
+                packet(i)->~Packet();
+            }
+        }
+    }
+
+    // size is at most blkSize, the data starts out stale
+    PacketPtr acquire(MemCmd cmd, Addr addr, unsigned size,
+                      Request::FlagsType flags, RequestorID requestor) {
+        assert(!freeSlots.empty() && size <= blkSize);
+        size_t i = freeSlots.back();
+        freeSlots.pop_back();
+
+        // memory may still hold the previous request, only reuse it
+        // once nothing else does
+        RequestPtr &req = reqs[i];
+        if (req && req.use_count() == 1) {
+            req->~Request();
+            new (req.get()) Request(addr, size, flags, requestor);
+        } else {
+            req = std::make_shared<Request>(addr, size, flags, requestor);
+        }
+
+        PacketPtr pkt = new (&storage[i]) Packet(req, cmd);
+        pkt->dataStatic(&data[i * blkSize]);
+        live[i] = 1;
+        return pkt;
+    }
+
+    void release(PacketPtr pkt) {
+        size_t i = reinterpret_cast<Slot *>(pkt) - storage.data();
+        assert(i < storage.size() && live[i]);
+        pkt->~Packet();
+        live[i] = 0;
+        freeSlots.push_back(i);
+    }
+
+   private:
+    using Slot = std::aligned_storage_t<sizeof(Packet), alignof(Packet)>;
+
+    PacketPtr packet(size_t i) {
+        return std::launder(reinterpret_cast<PacketPtr>(&storage[i]));
+    }
+
+    unsigned blkSize = 0;
+    std::vector<Slot> storage;
+    std::vector<RequestPtr> reqs;
+    std::vector<uint8_t> data;  // blkSize bytes per slot
+    std::vector<uint8_t> live;
+    std::vector<size_t> freeSlots;
+};
+}
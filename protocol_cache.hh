@@ -0,0 +1,201 @@
+#pragma once
+
+#include "base/trace.hh"
+#include "debug/CCache.hh"
+
+#include "src_740/coherent_cache_base.hh"
+#include "src_740/protocol_table.hh"
+#include "src_740/serializing_bus.hh"
+
+namespace gem5 {
+
+// A snooping protocol run from its transition table. Protocol provides:
+//   NumStates, name, stateNames[NumStates], sharing[NumStates] and a
+//   static constexpr ProtocolTable<NumStates> table
+// State 0 is Invalid, the shared storage in CoherentCacheBase treats 0 as
+// Invalid. Tables are checked when the cache is compiled, see
+// protocol_table.hh. The hooks are final, CoherentCacheBase calls them
+// once per event and each one only indexes the constexpr table.
+template <typename Protocol>
+class ProtocolCache : public CoherentCacheBase {
+    static_assert(checkTransitions<Protocol>(std::make_index_sequence<
+                      Protocol::NumStates * NumCoherenceEvents>()), "");
+    static_assert(sizeof(UnreachableStates<
+                      unreachableStates<Protocol>()>) > 0, "");
+
+   public:
+    ProtocolCache(const CoherentCacheBaseParams &params)
+        : CoherentCacheBase(params), protocolStats(this) {
+        updateProtocol = sendsUpdates<Protocol>();
+    }
+
+    bool satisfyCpuReq(PacketPtr pkt, int line) final {
+        CoherenceEvent event = pkt->isRead() ? CpuRead : CpuWrite;
+        const Transition &t =
+            transition(states[line], event, pkt->getAddr());
+        states[line] = t.next;
+        if (!t.has(ProtocolAction::Hit)) {
+            // keep the state until the bus is ours, a snoop may still
+            // take the line while we wait
+            return false;
+        }
+        if (t.has(ProtocolAction::SilentUpgrade)) {
+            protocolStats.silentUpgrades++;
+        }
+        accessLine(pkt, line);
+        sendCpuResp(pkt);
+        return true;
+    }
+
+    void handleCoherentBusGrant(Mshr* mshr) final {
+        // the line may have been invalidated while waiting for the bus
+        uint8_t state = lineState(mshr->blkAddr);
+        CoherenceEvent event =
+            mshr->hasWriteTarget() ? GrantWrite : GrantRead;
+        const Transition &t = transition(state, event, mshr->blkAddr);
+        if (t.has(ProtocolAction::SendUpdate)) {
+            mshr->writable = false;
+            busFor(mshr->blkAddr)->sendMemReq(createUpdatePacket(mshr),
+                                              false);
+            return;
+        }
+        MemCmd cmd = t.has(ProtocolAction::SendUpgrade) ? MemCmd::UpgradeReq
+                     : t.has(ProtocolAction::SendReadEx) ? MemCmd::ReadExReq
+                                                         : MemCmd::ReadReq;
+        mshr->writable = cmd != MemCmd::ReadReq;
+        // an upgrade holds valid data, only other copies are invalidated
+        busFor(mshr->blkAddr)->sendMemReq(createBlockPacket(cmd, mshr),
+                                          cmd != MemCmd::UpgradeReq);
+    }
+
+    void handleCoherentMemResp(PacketPtr pkt, Mshr* mshr) final {
+        SerializingBus* bus = busFor(mshr->blkAddr);
+        // an upgrade or update reuses its line, a miss allocates a new one
+        int line = findLine(pkt->getAddr());
+        CoherenceEvent event;
+        if (pkt->cmd == MemCmd::UpgradeResp) {
+            assert(line >= 0);
+            event = FillUpgrade;
+        } else if (pkt->cmd == MemCmd::WriteResp) {
+            assert(line >= 0);
+            event = pkt->hasSharers() ? UpdateShared : UpdateAlone;
+        } else {
+            assert(line < 0);
+            line = allocate(pkt->getAddr());
+            pkt->writeData(lineData(line));
+            event = mshr->writable ? FillWritable
+                    : pkt->hasSharers() ? FillShared
+                                        : FillExclusive;
+        }
+        bool kept = event == FillUpgrade || event == UpdateShared ||
+                    event == UpdateAlone;
+        const Transition &t =
+            transition(kept ? states[line] : 0, event, pkt->getAddr());
+        // a previous owner may have handed over dirty data without
+        // writing it back, so this cache is now responsible for it
+        if (t.has(ProtocolAction::TakeDirty) && pkt->cacheResponding()) {
+            dirty[line] = 1;
+        }
+        states[line] = t.next;
+        busPackets.release(pkt);
+
+        // the other holders have the update, now perform the write
+        if (kept && event != FillUpgrade) {
+            PacketPtr target = mshr->targets.front();
+            mshr->targets.pop_front();
+            accessLine(target, line);
+            sendCpuResp(target);
+        }
+
+        // the CPU has been waiting for a response. Serve it from the line.
+        serviceMshr(mshr, line);
+
+        // release the bus so other caches can use it
+        bus->release(cacheId);
+    }
+
+    void handleCoherentSnoopedReq(PacketPtr pkt) final {
+        int line = findLine(pkt->getAddr());
+        if (line < 0) {
+            DPRINTF(CCache, "%s[%d] snoop miss %#x\n\n", Protocol::name,
+                    cacheId, pkt->getAddr());
+            return;
+        }
+        protocolStats.snoopHits[states[line]]++;
+        // a cacheable write on the bus is an update
+        CoherenceEvent event = pkt->cmd == MemCmd::WriteReq ? SnoopUpdate
+                               : pkt->needsWritable()       ? SnoopWrite
+                                                            : SnoopRead;
+        const Transition &t =
+            transition(states[line], event, pkt->getAddr());
+
+        if (t.has(ProtocolAction::SetSharers)) {
+            pkt->setHasSharers();
+        }
+        bool supplied = false;
+        if (t.has(ProtocolAction::SupplyOwned)) {
+            supplied = supplyData(pkt, line, true);
+        } else if (t.has(ProtocolAction::SupplyClean)) {
+            supplied = supplyData(pkt, line, false);
+        }
+        // the requester of a ReadEx takes over dirty data it was given
+        if (t.has(ProtocolAction::Writeback) ||
+            (t.has(ProtocolAction::WritebackUnlessSupplied) && !supplied)) {
+            writeback(line);
+        }
+        if (t.has(ProtocolAction::UpdateData)) {
+            pkt->writeDataToBlock(lineData(line), blkSize);
+            dirty[line] = 0;
+        }
+        if (t.has(ProtocolAction::Invalidate)) {
+            invalidate(line);
+        } else {
+            states[line] = t.next;
+        }
+    }
+
+    Sharing sharing(int line) const final {
+        return Protocol::sharing[states[line]];
+    }
+
+    // prefetches are plain reads, a protocol that reads for ownership
+    // would take lines away from the caches using them
+    bool canPrefetch() const final {
+        return !Protocol::table.at(0, GrantRead).has(
+            ProtocolAction::SendReadEx);
+    }
+
+    struct ProtocolStats : public statistics::Group {
+        ProtocolStats(statistics::Group *parent)
+            : statistics::Group(parent, Protocol::name),
+              ADD_STAT(snoopHits, statistics::units::Count::get(),
+                       "snoops that found the line, by state"),
+              ADD_STAT(silentUpgrades, statistics::units::Count::get(),
+                       "writes that gained ownership without the bus")
+        {
+            snoopHits.init(Protocol::NumStates).flags(statistics::nozero);
+            for (unsigned s = 0; s < Protocol::NumStates; s++) {
+                snoopHits.subname(s, Protocol::stateNames[s]);
+            }
+            silentUpgrades.flags(statistics::nozero);
+        }
+
+        statistics::Vector snoopHits;  // by state
+        statistics::Scalar silentUpgrades;
+    } protocolStats;
+
+   private:
+    // the table is checked when it is compiled, every transition the
+    // caches can run into is defined
+    const Transition &transition(uint8_t state, CoherenceEvent event,
+                                 Addr addr) const {
+        assert(state < Protocol::NumStates);
+        const Transition &t = Protocol::table.at(state, event);
+        assert(t.defined());
+        DPRINTF(CCache, "%s[%d] %#x %s: %s -> %s\n\n", Protocol::name,
+                cacheId, addr, coherenceEventNames[event],
+                Protocol::stateNames[state], Protocol::stateNames[t.next]);
+        return t;
+    }
+};
+}
@@ -0,0 +1,224 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+
+namespace gem5 {
+
+// Building blocks for declaring a snooping protocol as a state x event
+// table, see ProtocolCache. State 0 is always Invalid.
+
+enum CoherenceEvent : uint8_t {
+    CpuRead,  // CPU access to a valid line
+    CpuWrite,
+    GrantRead,  // bus granted to an MSHR with only read targets
+    GrantWrite,  // bus granted to an MSHR with a write target
+    FillShared,  // read fill, another cache holds the line
+    FillExclusive,  // read fill, no other copy
+    FillWritable,  // fill for a ReadEx
+    FillUpgrade,  // upgrade done, the line was kept
+    UpdateShared,  // update broadcast, other caches still hold the line
+    UpdateAlone,  // update broadcast, no other copy
+    SnoopRead,  // another cache's read
+    SnoopWrite,  // another cache's ReadEx or upgrade
+    SnoopUpdate,  // another cache's update broadcast
+    NumCoherenceEvents
+};
+
+constexpr const char *coherenceEventNames[NumCoherenceEvents] = {
+    "CpuRead", "CpuWrite", "GrantRead", "GrantWrite", "FillShared",
+    "FillExclusive", "FillWritable", "FillUpgrade", "UpdateShared",
+    "UpdateAlone", "SnoopRead", "SnoopWrite", "SnoopUpdate"};
+
+// What a transition does besides moving to its next state. An update is
+// a WriteReq with the data of one CPU write; the other holders write it
+// into their copy instead of dropping it, and the writer applies it when
+// the broadcast is done. Memory does not see it, the writer becomes the
+// owner.
+namespace ProtocolAction {
+enum : uint16_t {
+    Hit = 1 << 0,  // CPU: serve from the line, otherwise it needs the bus
+    SilentUpgrade = 1 << 1,  // CPU: counted, a write without the bus
+    SendRead = 1 << 2,  // grant: ReadReq
+    SendReadEx = 1 << 3,  // grant: ReadExReq, the fill is writable
+    SendUpgrade = 1 << 4,  // grant: UpgradeReq, not sent to memory
+    SendUpdate = 1 << 5,  // grant: broadcast the first write, see below
+    TakeDirty = 1 << 6,  // fill: data handed over by an owner is dirty
+    SetSharers = 1 << 7,  // snoop: the requester may not fill exclusive
+    SupplyOwned = 1 << 8,  // snoop: respond with the data
+    SupplyClean = 1 << 9,  // snoop: respond if the bus forwards clean data
+    Writeback = 1 << 10,  // snoop: write dirty data back, the line stays
+    WritebackUnlessSupplied = 1 << 11,
+    Invalidate = 1 << 12,  // snoop: drop the line
+    UpdateData = 1 << 13,  // snoop: take an update, the writer owns the line
+};
+}
+
+struct Transition {
+    static const uint8_t Undefined = 0xff;
+
+    uint8_t next = Undefined;
+    uint16_t actions = 0;
+
+    constexpr bool defined() const { return next != Undefined; }
+    constexpr bool has(uint16_t action) const { return actions & action; }
+};
+
+template <unsigned NumStates>
+struct ProtocolTable {
+    Transition entries[NumStates][NumCoherenceEvents] = {};
+
+    constexpr void on(uint8_t state, CoherenceEvent event, uint8_t next,
+                      uint16_t actions = 0) {
+        entries[state][event].next = next;
+        entries[state][event].actions = actions;
+    }
+
+    constexpr const Transition &at(uint8_t state, CoherenceEvent event) const {
+        return entries[state][event];
+    }
+};
+
+// The transitions the caches can run into: CPU accesses in every valid
+// state, grants from Invalid and from every state a write misses in, and
+// what those grants lead to. All caches on a bus run the same protocol,
+// so valid lines see read and write snoops only if some grant sends that
+// kind of request. Holders of a line another cache updates are in states
+// that send updates themselves.
+template <typename P>
+struct ReachableTransitions {
+    bool events[P::NumStates][NumCoherenceEvents] = {};
+
+    constexpr ReachableTransitions() {
+        const auto &table = P::table;
+        bool snoopRead = false;
+        bool snoopWrite = false;
+        auto grant = [&](unsigned state, CoherenceEvent event) {
+            events[state][event] = true;
+            const Transition &t = table.at(state, event);
+            snoopRead |= t.has(ProtocolAction::SendRead);
+            snoopWrite |= t.has(ProtocolAction::SendReadEx) ||
+                          t.has(ProtocolAction::SendUpgrade);
+            if (t.has(ProtocolAction::SendRead)) {
+                events[0][FillShared] = true;
+                events[0][FillExclusive] = true;
+            }
+            if (t.has(ProtocolAction::SendReadEx)) {
+                events[0][FillWritable] = true;
+            }
+            if (t.has(ProtocolAction::SendUpgrade)) {
+                events[state][FillUpgrade] = true;
+            }
+            if (t.has(ProtocolAction::SendUpdate)) {
+                events[state][UpdateShared] = true;
+                events[state][UpdateAlone] = true;
+                events[state][SnoopUpdate] = true;
+            }
+        };
+
+        grant(0, GrantRead);
+        grant(0, GrantWrite);
+        for (unsigned state = 1; state < P::NumStates; state++) {
+            events[state][CpuRead] = true;
+            events[state][CpuWrite] = true;
+            if (!table.at(state, CpuWrite).has(ProtocolAction::Hit)) {
+                grant(state, GrantWrite);
+            }
+        }
+        for (unsigned state = 1; state < P::NumStates; state++) {
+            events[state][SnoopRead] = snoopRead;
+            events[state][SnoopWrite] = snoopWrite;
+        }
+    }
+};
+
+template <typename P>
+inline constexpr ReachableTransitions<P> reachableTransitions{};
+
+// transitions coded state * NumCoherenceEvents + event. Missing: the
+// caches can run into it but the table leaves it undefined.
+template <typename P>
+constexpr bool transitionMissing(unsigned code) {
+    unsigned state = code / NumCoherenceEvents;
+    auto event = static_cast<CoherenceEvent>(code % NumCoherenceEvents);
+    return reachableTransitions<P>.events[state][event] &&
+           !P::table.at(state, event).defined();
+}
+
+// defined but can never run, e.g. a fill into a valid line, a snoop on
+// an Invalid one or an upgrade from a state that writes without the bus
+template <typename P>
+constexpr bool transitionUnused(unsigned code) {
+    unsigned state = code / NumCoherenceEvents;
+    auto event = static_cast<CoherenceEvent>(code % NumCoherenceEvents);
+    return !reachableTransitions<P>.events[state][event] &&
+           P::table.at(state, event).defined();
+}
+
+// states no sequence of transitions from Invalid leads to, bit per state
+template <typename P>
+constexpr uint64_t unreachableStates() {
+    static_assert(P::NumStates <= 64, "states are checked in a 64 bit mask");
+    const auto &table = P::table;
+    uint64_t reached = 1;
+    for (unsigned round = 0; round < P::NumStates; round++) {
+        for (unsigned state = 0; state < P::NumStates; state++) {
+            if (!(reached & (uint64_t(1) << state))) {
+                continue;
+            }
+            for (unsigned e = 0; e < NumCoherenceEvents; e++) {
+                const Transition &t =
+                    table.at(state, static_cast<CoherenceEvent>(e));
+                if (t.defined() && t.next < P::NumStates) {
+                    reached |= uint64_t(1) << t.next;
+                }
+            }
+        }
+    }
+    return ~reached & ((uint64_t(1) << P::NumStates) - 1);
+}
+
+// whether some grant broadcasts an update, whose line must then stay
+template <typename P>
+constexpr bool sendsUpdates() {
+    for (unsigned state = 0; state < P::NumStates; state++) {
+        for (unsigned e = 0; e < NumCoherenceEvents; e++) {
+            if (P::table.at(state, static_cast<CoherenceEvent>(e))
+                    .has(ProtocolAction::SendUpdate)) {
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+// instantiated with the results above, a failing table names the
+// offending state and event in the compiler error
+template <bool Found, unsigned State, CoherenceEvent Event>
+struct MissingTransition {
+    static_assert(!Found, "protocol table lacks a transition");
+};
+template <bool Found, unsigned State, CoherenceEvent Event>
+struct UnusedTransition {
+    static_assert(!Found, "protocol table has a transition that never runs");
+};
+template <uint64_t Bits>
+struct UnreachableStates {
+    static_assert(Bits == 0, "protocol table has unreachable states");
+};
+
+// one check per transition, so every bad one is reported
+template <typename P, size_t... Code>
+constexpr bool checkTransitions(std::index_sequence<Code...>) {
+    return (0 + ... +
+            (sizeof(MissingTransition<transitionMissing<P>(Code),
+                                      Code / NumCoherenceEvents,
+                                      static_cast<CoherenceEvent>(
+                                          Code % NumCoherenceEvents)>) +
+             sizeof(UnusedTransition<transitionUnused<P>(Code),
+                                     Code / NumCoherenceEvents,
+                                     static_cast<CoherenceEvent>(
+                                         Code % NumCoherenceEvents)>))) > 0;
+}
+}
@@ -0,0 +1,148 @@
+#include "src_740/replacement_policy.hh"
+#include "base/intmath.hh"
+#include "base/logging.hh"
+#include "base/random.hh"
+
+#include <algorithm>
+
+namespace gem5 {
+
+std::unique_ptr<ReplPolicy> ReplPolicy::create(enums::CoherentReplPolicy type,
+                                               unsigned numSets,
+                                               unsigned assoc) {
+    switch (type) {
+      case enums::CoherentReplPolicy::LRU:
+        return std::make_unique<LruReplPolicy>(numSets, assoc);
+      case enums::CoherentReplPolicy::TreePLRU:
+        return std::make_unique<TreePlruReplPolicy>(numSets, assoc);
+      case enums::CoherentReplPolicy::SRRIP:
+        return std::make_unique<RripReplPolicy>(numSets, assoc, false);
+      case enums::CoherentReplPolicy::BRRIP:
+        return std::make_unique<RripReplPolicy>(numSets, assoc, true);
+      case enums::CoherentReplPolicy::Random:
+        return std::make_unique<RandomReplPolicy>(numSets, assoc);
+      default:
+        panic("unknown replacement policy %d\n", static_cast<int>(type));
+    }
+}
+
+LruReplPolicy::LruReplPolicy(unsigned numSets, unsigned assoc)
+    : ReplPolicy(numSets, assoc), lastUse(numSets * assoc, 0) {}
+
+unsigned LruReplPolicy::victim(unsigned set, const uint8_t *pinned) {
+    unsigned base = set * assoc;
+    int victim = -1;
+    for (unsigned way = 0; way < assoc; way++) {
+        unsigned line = base + way;
+        if (!isPinned(pinned, way) &&
+            (victim < 0 || lastUse[line] < lastUse[victim])) {
+            victim = line;
+        }
+    }
+    assert(victim >= 0);
+    return victim;
+}
+
+TreePlruReplPolicy::TreePlruReplPolicy(unsigned numSets, unsigned assoc)
+    : ReplPolicy(numSets, assoc), bits(numSets, 0) {
+    fatal_if(!isPowerOf2(assoc) || assoc > 64,
+             "tree-PLRU needs a power of 2 assoc of at most 64\n");
+}
+
+void TreePlruReplPolicy::point(unsigned line, bool towards) {
+    unsigned set = line / assoc;
+    unsigned way = line % assoc;
+    unsigned node = 0;
+    // walk from the root, one level per way index bit, msb first
+    for (unsigned level = floorLog2(assoc); level > 0; level--) {
+        bool right = (way >> (level - 1)) & 1;
+        // a set bit points right, so point left after using the right half
+        if (right == towards) {
+            bits[set] |= (uint64_t(1) << node);
+        } else {
+            bits[set] &= ~(uint64_t(1) << node);
+        }
+        node = 2 * node + (right ? 2 : 1);
+    }
+}
+
+void TreePlruReplPolicy::touch(unsigned line) {
+    point(line, false);
+}
+
+void TreePlruReplPolicy::invalidate(unsigned line) {
+    point(line, true);
+}
+
+unsigned TreePlruReplPolicy::victim(unsigned set, const uint8_t *pinned) {
+    unsigned node = 0;
+    unsigned way = 0;
+    for (unsigned level = floorLog2(assoc); level > 0; level--) {
+        bool right = (bits[set] >> node) & 1;
+        // leave a subtree of pinned ways for its sibling
+        if (pinned) {
+            unsigned span = 1 << (level - 1);
+            unsigned first = ((way << 1) | right) * span;
+            bool allPinned = true;
+            for (unsigned w = first; w < first + span; w++) {
+                allPinned = allPinned && pinned[w];
+            }
+            right ^= allPinned;
+        }
+        way = (way << 1) | right;
+        node = 2 * node + (right ? 2 : 1);
+    }
+    assert(!isPinned(pinned, way));
+    return set * assoc + way;
+}
+
+RripReplPolicy::RripReplPolicy(unsigned numSets, unsigned assoc, bool bimodal)
+    : ReplPolicy(numSets, assoc), bimodal(bimodal),
+      rrpv(numSets * assoc, maxRrpv) {}
+
+void RripReplPolicy::insert(unsigned line) {
+    if (bimodal && random_mt.random<unsigned>(0, btp - 1) != 0) {
+        rrpv[line] = maxRrpv;
+    } else {
+        rrpv[line] = maxRrpv - 1;
+    }
+}
+
+unsigned RripReplPolicy::victim(unsigned set, const uint8_t *pinned) {
+    unsigned base = set * assoc;
+    // age the whole set until some line reaches a distant re-reference
+    int oldest = -1;
+    unsigned victim = base;
+    for (unsigned way = 0; way < assoc; way++) {
+        unsigned line = base + way;
+        if (!isPinned(pinned, way) && rrpv[line] > oldest) {
+            oldest = rrpv[line];
+            victim = line;
+        }
+    }
+    assert(oldest >= 0);
+    if (oldest < maxRrpv) {
+        // pinned ways may already be older than the victim
+        uint8_t age = maxRrpv - oldest;
+        for (unsigned line = base; line < base + assoc; line++) {
+            rrpv[line] = std::min<unsigned>(rrpv[line] + age, maxRrpv);
+        }
+    }
+    return victim;
+}
+
+unsigned RandomReplPolicy::victim(unsigned set, const uint8_t *pinned) {
+    unsigned candidates = assoc;
+    for (unsigned way = 0; pinned && way < assoc; way++) {
+        candidates -= pinned[way] != 0;
+    }
+    assert(candidates);
+    unsigned pick = random_mt.random<unsigned>(0, candidates - 1);
+    for (unsigned way = 0;; way++) {
+        if (!isPinned(pinned, way) && pick-- == 0) {
+            return set * assoc + way;
+        }
+    }
+}
+
+}
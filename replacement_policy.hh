@@ -0,0 +1,109 @@
+#pragma once
+
+#include "base/types.hh"
+#include "enums/CoherentReplPolicy.hh"
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace gem5 {
+
+// Victim selection for the set-associative storage in CoherentCacheBase.
+// Lines are addressed by their index in the cache (set * assoc + way).
+// Each policy keeps its metadata in a flat per-line or per-set array.
+class ReplPolicy {
+   public:
+    ReplPolicy(unsigned numSets, unsigned assoc)
+        : numSets(numSets), assoc(assoc) {}
+    virtual ~ReplPolicy() {}
+
+    // a CPU access hit the line
+    virtual void touch(unsigned line) = 0;
+    // the line was just filled
+    virtual void insert(unsigned line) = 0;
+    // the line was invalidated, it should be picked first
+    virtual void invalidate(unsigned line) = 0;
+    // returns the line to replace in a set with no invalid ways. Ways
+    // set in pinned (assoc entries, or null) are not picked, at least one
+    // must be left.
+    virtual unsigned victim(unsigned set, const uint8_t *pinned) = 0;
+
+    static std::unique_ptr<ReplPolicy> create(enums::CoherentReplPolicy type,
+                                              unsigned numSets,
+                                              unsigned assoc);
+
+   protected:
+    const unsigned numSets;
+    const unsigned assoc;
+
+    static bool isPinned(const uint8_t *pinned, unsigned way) {
+        return pinned && pinned[way];
+    }
+};
+
+// true LRU, per-line last-use stamps
+class LruReplPolicy : public ReplPolicy {
+   public:
+    LruReplPolicy(unsigned numSets, unsigned assoc);
+
+    void touch(unsigned line) override { lastUse[line] = ++useCount; }
+    void insert(unsigned line) override { lastUse[line] = ++useCount; }
+    void invalidate(unsigned line) override { lastUse[line] = 0; }
+    unsigned victim(unsigned set, const uint8_t *pinned) override;
+
+   private:
+    uint64_t useCount = 0;
+    std::vector<uint64_t> lastUse;
+};
+
+// tree pseudo-LRU, assoc - 1 direction bits per set packed in one word.
+// Node i has children 2i+1 and 2i+2, a set bit points to the right subtree.
+class TreePlruReplPolicy : public ReplPolicy {
+   public:
+    TreePlruReplPolicy(unsigned numSets, unsigned assoc);
+
+    void touch(unsigned line) override;
+    void insert(unsigned line) override { touch(line); }
+    void invalidate(unsigned line) override;
+    unsigned victim(unsigned set, const uint8_t *pinned) override;
+
+   private:
+    // points every node on the path to way towards it (or away from it)
+    void point(unsigned line, bool towards);
+
+    std::vector<uint64_t> bits;
+};
+
+// static (SRRIP) and bimodal (BRRIP) re-reference interval prediction
+// with 2-bit RRPVs
+class RripReplPolicy : public ReplPolicy {
+   public:
+    RripReplPolicy(unsigned numSets, unsigned assoc, bool bimodal);
+
+    void touch(unsigned line) override { rrpv[line] = 0; }
+    void insert(unsigned line) override;
+    void invalidate(unsigned line) override { rrpv[line] = maxRrpv; }
+    unsigned victim(unsigned set, const uint8_t *pinned) override;
+
+   private:
+    static constexpr uint8_t maxRrpv = 3;
+    // BRRIP inserts with a long interval except once every btp fills
+    static constexpr unsigned btp = 32;
+
+    const bool bimodal;
+    std::vector<uint8_t> rrpv;
+};
+
+class RandomReplPolicy : public ReplPolicy {
+   public:
+    RandomReplPolicy(unsigned numSets, unsigned assoc)
+        : ReplPolicy(numSets, assoc) {}
+
+    void touch(unsigned line) override {}
+    void insert(unsigned line) override {}
+    void invalidate(unsigned line) override {}
+    unsigned victim(unsigned set, const uint8_t *pinned) override;
+};
+
+}
@@ -0,0 +1,108 @@
+#pragma once
+
+#include <cassert>
+#include <cstddef>
+#include <utility>
+#include <vector>
+
+namespace gem5 {
+
+// FIFO on a power-of-two ring that doubles when it is full. Once it has
+// grown to the deepest backlog seen, pushes and pops never allocate,
+// unlike a std::list that allocates a node per element. A fixed ring
+// asserts rather than hold more than capacity, for queues whose depth
+// the params bound.
+template <typename T>
+class RingQueue {
+   public:
+    explicit RingQueue(size_t capacity = 8, bool fixed = false)
+        : slots(roundUp(capacity)), limit(fixed ? capacity : 0) {}
+
+    bool empty() const { return count == 0; }
+    size_t size() const { return count; }
+
+    // i-th element from the front
+    T &operator[](size_t i) { return slots[(head + i) & mask()]; }
+    const T &operator[](size_t i) const {
+        return slots[(head + i) & mask()];
+    }
+
+    T &front() { assert(count); return slots[head]; }
+    const T &front() const { assert(count); return slots[head]; }
+    T &back() { assert(count); return (*this)[count - 1]; }
+    const T &back() const { assert(count); return (*this)[count - 1]; }
+
+    void push_back(const T &value) {
+        assert(limit == 0 || count < limit);
+        if (count == slots.size()) {
+            grow();
+        }
+        slots[(head + count) & mask()] = value;
+        count++;
+    }
+
+    void pop_front() {
+        assert(count);
+        head = (head + 1) & mask();
+        count--;
+    }
+
+    // removes the i-th element, the ones behind it move up
+    void erase(size_t i) {
+        assert(i < count);
+        for (; i + 1 < count; i++) {
+            (*this)[i] = std::move((*this)[i + 1]);
+        }
+        count--;
+    }
+
+    void clear() {
+        head = 0;
+        count = 0;
+    }
+
+    template <typename Queue, typename Value>
+    class Iterator {
+       public:
+        Iterator(Queue *queue, size_t i) : queue(queue), i(i) {}
+        Value &operator*() const { return (*queue)[i]; }
+        Iterator &operator++() { i++; return *this; }
+        bool operator!=(const Iterator &other) const { return i != other.i; }
+
+       private:
+        Queue *queue;
+        size_t i;
+    };
+    using iterator = Iterator<RingQueue, T>;
+    using const_iterator = Iterator<const RingQueue, const T>;
+    iterator begin() { return iterator(this, 0); }
+    iterator end() { return iterator(this, count); }
+    const_iterator begin() const { return const_iterator(this, 0); }
+    const_iterator end() const { return const_iterator(this, count); }
+
+   private:
+    std::vector<T> slots;
+    size_t head = 0;
+    size_t count = 0;
+    size_t limit;  // 0 if the ring grows
+
+    size_t mask() const { return slots.size() - 1; }
+
+    static size_t roundUp(size_t n) {
+        size_t size = 1;
+        while (size < n) {
+            size <<= 1;
+        }
+        return size;
+    }
+
+    void grow() {
+        std::vector<T> bigger(slots.size() * 2);
+        for (size_t i = 0; i < count; i++) {
+            bigger[i] = std::move((*this)[i]);
+        }
+        slots.swap(bigger);
+        head = 0;
+    }
+};
+}
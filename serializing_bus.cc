@@ -1,7 +1,10 @@
 #include "src_740/serializing_bus.hh"
+#include "base/cast.hh"
+#include "base/intmath.hh"
 #include "base/trace.hh"
 #include "debug/SBus.hh"
 #include <iostream>
+#include <typeinfo>
 
 namespace gem5 {
 
@@ -9,34 +12,312 @@ SerializingBus::SerializingBus(const SerializingBusParams& params)
     : SimObject(params),
       memPort(params.name + ".mem_side", this),
       memReqEvent([this](){ processMemReqEvent(); }, name()), 
-      grantEvent([this](){ processGrantEvent(); }, name()) {}
+      arbitrationLatency(params.arbitration_latency),
+      busWidth(params.bus_width),
+      beatLatency(params.transfer_latency),
+      splitTransaction(params.split_transaction),
+      maxOutstanding(params.max_outstanding),
+      blkSize(params.block_size),
+      grantEvent([this](){ processGrantEvent(); }, name()),
+      forwardClean(params.forward_clean),
+      directory(params.directory),
+      trace(params.trace),
+      stats(this) {
+    fatal_if(!isPowerOf2(blkSize),
+             "%s: block size must be a power of 2\n", name());
+    fatal_if(busWidth == 0, "%s: bus_width must be at least 1\n", name());
+    fatal_if(splitTransaction && maxOutstanding == 0,
+             "%s: split transactions need max_outstanding > 0\n", name());
+    fatal_if(directory && params.snoop_filter_entries,
+             "%s: use either a directory or a snoop filter\n", name());
+    fatal_if(directory && directory->blockSize() != blkSize,
+             "%s: directory has %d byte blocks, the bus %d\n", name(),
+             directory->blockSize(), blkSize);
+    arbiter = BusArbiter::create(params.arbitration,
+                                 params.arbiter_priorities,
+                                 params.arbiter_weights);
+    if (params.snoop_filter_entries) {
+        snoopFilter = std::make_unique<SnoopFilter>(
+            params.snoop_filter_entries, params.snoop_filter_assoc, blkSize);
+    }
+    if (splitTransaction) {
+        // transactions past the address phase, parked or not, never
+        // exceed maxOutstanding
+        pendingLines.resize(maxOutstanding);
+        for (auto& line : pendingLines) {
+            line.parked = RingQueue<MemReq>(maxOutstanding, true);
+        }
+        memPort.waitingPackets = RingQueue<PacketPtr>(maxOutstanding, true);
+        senderStates.resize(maxOutstanding);
+        for (auto& state : senderStates) {
+            freeSenderStates.push_back(&state);
+        }
+    }
+}
+
+SerializingBus::SerializingBusStats::SerializingBusStats(
+    statistics::Group *parent)
+    : statistics::Group(parent),
+      ADD_STAT(snoopsSent, statistics::units::Count::get(),
+               "snoops sent to caches"),
+      ADD_STAT(snoopsFiltered, statistics::units::Count::get(),
+               "snoops a broadcast would have sent but were skipped"),
+      ADD_STAT(filteredFraction, statistics::units::Ratio::get(),
+               "fraction of snoops filtered out",
+               snoopsFiltered / (snoopsSent + snoopsFiltered)),
+      ADD_STAT(backInvalidations, statistics::units::Count::get(),
+               "snoop filter entries replaced while caches held the line"),
+      ADD_STAT(busyTicks, statistics::units::Tick::get(),
+               "ticks the bus was granted to a cache"),
+      ADD_STAT(idleTicks, statistics::units::Tick::get(),
+               "ticks the bus was free"),
+      ADD_STAT(utilization, statistics::units::Ratio::get(),
+               "fraction of ticks the bus was busy",
+               busyTicks / (busyTicks + idleTicks)),
+      ADD_STAT(queueDepth, statistics::units::Count::get(),
+               "bus requests already queued when a new one arrives"),
+      ADD_STAT(grantWait, statistics::units::Tick::get(),
+               "ticks from a bus request to its grant"),
+      ADD_STAT(transactions, statistics::units::Count::get(),
+               "transactions started, by type"),
+      ADD_STAT(bytes, statistics::units::Byte::get(),
+               "request and response data moved, by transaction type"),
+      ADD_STAT(cacheSupplied, statistics::units::Count::get(),
+               "transactions answered by a cache instead of memory"),
+      ADD_STAT(snoopsPerTransaction, statistics::units::Count::get(),
+               "caches snooped by each snooping transaction")
+{
+    queueDepth.init(16);
+    grantWait.init(16);
+    snoopsPerTransaction.init(16);
+    transactions.init(NumTransTypes)
+        .subname(Read, "read")
+        .subname(WriteInv, "writeInv")
+        .subname(Update, "update")
+        .subname(Uncacheable, "uncacheable")
+        .subname(Writeback, "writeback");
+    bytes.init(NumTransTypes)
+        .subname(Read, "read")
+        .subname(WriteInv, "writeInv")
+        .subname(Update, "update")
+        .subname(Uncacheable, "uncacheable")
+        .subname(Writeback, "writeback");
+}
 
 
 
 void SerializingBus::processMemReqEvent() {
-    while(!(memReqQueue.size() == 0)) {
-        auto first = memReqQueue.begin();
-        auto bundle = *first;
-        memReqQueue.erase(first);
+    while (!memReqQueue.empty() && memReqQueue.front().ready <= curTick()) {
+        MemReq bundle = memReqQueue.front();
+        memReqQueue.pop_front();
 
-        // send snoops
-        for (auto& it : cacheMap) {
-            if (it.first != currentGranted) {
-                it.second->handleSnoopedReq(bundle.first);
+        if (!splitTransaction) {
+            startTransaction(bundle);
+            continue;
+        }
+
+        // same block requests are answered in the order they got the bus
+        outstanding++;
+        Addr blk = blockAlign(bundle.pkt->getAddr());
+        PendingLine* line = findPending(blk);
+        if (line) {
+            DPRINTF(SBus, "%#x from %d waits for an earlier transaction\n\n",
+                    blk, bundle.cacheId);
+            line->parked.push_back(bundle);
+        } else {
+            claimPending(blk);
+            startTransaction(bundle);
+        }
+        endAddressPhase();
+    }
+    if (!memReqQueue.empty() && !memReqEvent.scheduled()) {
+        schedule(memReqEvent, memReqQueue.front().ready);
+    }
+}
+
+void SerializingBus::queueMemReq(MemReq req) {
+    req.ready = curTick() + requestLatency(req);
+    if (!memReqQueue.empty()) {
+        req.ready = std::max(req.ready, memReqQueue.back().ready);
+    }
+    memReqQueue.push_back(req);
+    if (!memReqEvent.scheduled()) {
+        schedule(memReqEvent, req.ready);
+    }
+}
+
+void SerializingBus::startTransaction(const MemReq& bundle) {
+    // a cacheable write is an update, see ProtocolAction::SendUpdate
+    bool update = bundle.snoop && !bundle.uncacheable &&
+                  bundle.pkt->cmd == MemCmd::WriteReq;
+    TransType type;
+    if (!bundle.snoop) {
+        type = Writeback;
+    } else if (bundle.uncacheable) {
+        type = Uncacheable;
+    } else if (update) {
+        type = Update;
+    } else if (bundle.pkt->needsWritable() || bundle.pkt->isWrite()) {
+        type = WriteInv;
+    } else {
+        type = Read;
+    }
+    stats.transactions[type]++;
+    // reads are answered with as much data as they ask for
+    if (bundle.pkt->hasData() || bundle.pkt->isRead()) {
+        stats.bytes[type] += bundle.pkt->getSize();
+    }
+
+    // send snoops, at most one cache supplies the data
+    int responder = -1;
+    if (bundle.snoop) {
+        std::vector<int>& targets = snoopScratch;
+        targets.clear();
+        snoopTargets(bundle, targets);
+        stats.snoopsPerTransaction.sample(targets.size());
+        for (int id : targets) {
+            cacheMap[id]->handleSnoopedReq(bundle.pkt);
+            if (responder == -1 && bundle.pkt->cacheResponding()) {
+                responder = id;
             }
         }
+        // the holders of an updated line keep it
+        if (directory && bundle.pkt->needsWritable() && !update) {
+            directory->ownershipTaken(blockAlign(bundle.pkt->getAddr()),
+                                      bundle.cacheId);
+        }
+    }
+
+    if (trace) {
+        trace->record(CoherenceTrace::Transaction, bundle.cacheId,
+                      bundle.pkt->getAddr(), bundle.pkt->cmd, 0, 0,
+                      responder != -1 ? CoherenceTrace::SnoopSupplied : 0);
+    }
 
-        // send to memory system?
-        if (bundle.second) {
-            memPort.sendPacket(bundle.first);
+    // a snooper supplied the data, so the memory read is not needed.
+    // Dirty data has been handed over or written back by the responder.
+    if (responder != -1) {
+        stats.cacheSupplied++;
+        DPRINTF(SBus, "%d supplied %#x to %d\n\n", responder,
+                bundle.pkt->getAddr(), bundle.cacheId);
+        bundle.pkt->makeResponse();
+        deliverResponse(bundle.cacheId, bundle.pkt);
+    }
+    // send to memory system?
+    else if (bundle.sendToMemory && atomicActive) {
+        atomicLatency += memPort.sendAtomic(bundle.pkt);
+        deliverResponse(bundle.cacheId, bundle.pkt);
+    }
+    else if (bundle.sendToMemory) {
+        if (splitTransaction) {
+            assert(!freeSenderStates.empty());
+            BusSenderState* state = freeSenderStates.back();
+            freeSenderStates.pop_back();
+            state->cacheId = bundle.cacheId;
+            bundle.pkt->pushSenderState(state);
         }
-        else {
-            // cannot be a read packet!
-            assert(!bundle.first->isRead());
-            bundle.first->makeResponse();
-            cacheMap[currentGranted]->handleResponse(bundle.first);
+        memPort.sendPacket(bundle.pkt);
+    }
+    else {
+        // cannot be a read packet!
+        assert(!bundle.pkt->isRead());
+        bundle.pkt->makeResponse();
+        deliverResponse(bundle.cacheId, bundle.pkt);
+    }
+}
+
+SerializingBus::PendingLine* SerializingBus::findPending(Addr blk) {
+    for (auto& line : pendingLines) {
+        if (line.busy && line.blk == blk) {
+            return &line;
         }
     }
+    return nullptr;
+}
+
+SerializingBus::PendingLine* SerializingBus::claimPending(Addr blk) {
+    // at most max_outstanding blocks are in flight
+    for (auto& line : pendingLines) {
+        if (!line.busy) {
+            line.blk = blk;
+            line.busy = true;
+            return &line;
+        }
+    }
+    panic("%s: more than max_outstanding transactions\n", name());
+}
+
+void SerializingBus::snoopTargets(const MemReq& bundle,
+                                  std::vector<int>& targets) {
+    Addr blk = blockAlign(bundle.pkt->getAddr());
+    if (snoopFilter) {
+        snoopFilter->lookup(blk, bundle.cacheId, targets);
+    } else if (!directory ||
+               !directory->sharers(blk, bundle.cacheId, targets)) {
+        // broadcast
+        for (auto& it : cacheMap) {
+            if (it.first != bundle.cacheId) {
+                targets.push_back(it.first);
+            }
+        }
+    }
+
+    stats.snoopsSent += targets.size();
+    stats.snoopsFiltered += cacheMap.size() - 1 - targets.size();
+}
+
+Tick SerializingBus::requestLatency(const MemReq& req) const {
+    Tick latency = req.snoop ? snoopLatency : 0;
+    if (req.pkt->hasData()) {
+        latency += transferLatency(req.pkt->getSize());
+    }
+    return latency;
+}
+
+void SerializingBus::deliverResponse(int cacheId, PacketPtr pkt) {
+    if (pkt->hasData()) {
+        if (atomicActive) {
+            atomicLatency += transferLatency(pkt->getSize());
+        } else {
+            pkt->payloadDelay += transferLatency(pkt->getSize());
+        }
+    }
+
+    // the cache may free the packet
+    Addr blk = blockAlign(pkt->getAddr());
+    cacheMap[cacheId]->handleResponse(pkt);
+    if (!splitTransaction || atomicActive) {
+        return;
+    }
+
+    // let the next request to the block snoop
+    outstanding--;
+    PendingLine* line = findPending(blk);
+    assert(line);
+    if (line->parked.empty()) {
+        line->busy = false;
+    } else {
+        MemReq next = line->parked.front();
+        line->parked.pop_front();
+        startTransaction(next);
+    }
+
+    // grants may have been held back by maxOutstanding
+    if (currentGranted == -1 && (!arbiter->empty() || prefetchWaiting) &&
+        !grantEvent.scheduled()) {
+        schedule(grantEvent, curTick() + arbitrationLatency);
+    }
+}
+
+void SerializingBus::endAddressPhase() {
+    DPRINTF(SBus, "address phase of %d done, %d outstanding\n\n",
+            currentGranted, outstanding);
+    currentGranted = -1;
+    grantUsed = false;
+    busFreed();
+    if (!grantEvent.scheduled()) {
+        schedule(grantEvent, curTick() + arbitrationLatency);
+    }
 }
 
 Port& SerializingBus::getPort(const std::string& port_name, PortID idx) {
@@ -62,9 +343,16 @@ void SerializingBus::sendRangeChange() {
 }
 
 bool SerializingBus::handleResponse(PacketPtr pkt) {
-    assert(currentGranted != -1);
+    if (splitTransaction) {
+        auto state = safe_cast<BusSenderState*>(pkt->popSenderState());
+        int cacheId = state->cacheId;
+        freeSenderStates.push_back(state);
+        deliverResponse(cacheId, pkt);
+        return true;
+    }
 
-    cacheMap[currentGranted]->handleResponse(pkt);
+    assert(currentGranted != -1);
+    deliverResponse(currentGranted, pkt);
     return true;
 }
 
@@ -73,7 +361,12 @@ void SerializingBus::MemSidePort::recvRangeChange() {
 }
 
 void SerializingBus::MemSidePort::sendPacket(PacketPtr pkt) {
-    panic_if(blockedPacket != nullptr, "Should not try to send if blocked!");
+    if (blockedPacket != nullptr) {
+        panic_if(!owner->splitTransaction,
+                 "Should not try to send if blocked!");
+        waitingPackets.push_back(pkt);
+        return;
+    }
     if (!sendTimingReq(pkt)) {
         blockedPacket = pkt;
     }
@@ -86,10 +379,28 @@ void SerializingBus::MemSidePort::recvReqRetry() {
     blockedPacket = nullptr;
 
     sendPacket(pkt);
+    while (blockedPacket == nullptr && !waitingPackets.empty()) {
+        pkt = waitingPackets.front();
+        waitingPackets.pop_front();
+        sendPacket(pkt);
+    }
 }
 
 void SerializingBus::registerCache(int cacheId, CoherentCacheBase* cache) {
+    fatal_if(snoopFilter && (cacheId < 0 || cacheId >= SnoopFilter::maxCaches),
+             "%s: snoop filter supports cache ids 0-%d\n", name(),
+             SnoopFilter::maxCaches - 1);
+    // same line ordering and transfer times assume the bus block size
+    fatal_if(cache->blkSize != blkSize,
+             "%s: C[%d] has %d byte blocks, the bus %d\n", name(), cacheId,
+             cache->blkSize, blkSize);
+    // protocol tables only handle the snoops their own caches send
+    fatal_if(!cacheMap.empty() &&
+             typeid(*cache) != typeid(*cacheMap.begin()->second),
+             "%s: C[%d] runs a different protocol than the other caches\n",
+             name(), cacheId);
     cacheMap[cacheId] = cache;
+    snoopLatency = std::max(snoopLatency, cache->snoopLatency);
 }
 
 bool SerializingBus::MemSidePort::recvTimingResp(PacketPtr pkt) {
@@ -99,50 +410,270 @@ bool SerializingBus::MemSidePort::recvTimingResp(PacketPtr pkt) {
 void SerializingBus::processGrantEvent() {
     assert(currentGranted == -1);
 
-    if (busRequestQueue.size() != 0) {
-        auto requestIt = busRequestQueue.begin();
-        int requestingCache = *requestIt;
-        busRequestQueue.erase(requestIt);
+    // a response will grant again once a slot frees up
+    if (splitTransaction && outstanding >= maxOutstanding) {
+        DPRINTF(SBus, "%d transactions outstanding, grant held\n\n",
+                outstanding);
+        return;
+    }
+
+    if (arbiter->empty() && prefetchWaiting) {
+        inGrant = true;
+        offerIdle();
+        inGrant = false;
+    }
+
+    if (!arbiter->empty()) {
+        Tick waited;
+        int requestingCache = arbiter->grant(curTick(), waited);
+        cacheMap[requestingCache]->stats.busGrantWait.sample(waited);
+        stats.grantWait.sample(waited);
         currentGranted = requestingCache;
+        busAcquired();
         DPRINTF(SBus, "granting %d\n\n", currentGranted);
-        cacheMap[requestingCache]->handleBusGrant();
+        cacheMap[requestingCache]->handleBusGrant(this);
+    }
+}
+
+void SerializingBus::prefetchReady() {
+    prefetchWaiting = true;
+    if (currentGranted == -1 && !atomicActive && !grantEvent.scheduled()) {
+        schedule(grantEvent, curTick() + arbitrationLatency);
     }
 }
 
+void SerializingBus::offerIdle() {
+    // stays set while caches keep issuing, one may have more queued
+    prefetchWaiting = false;
+    auto it = cacheMap.upper_bound(lastPrefetcher);
+    for (size_t i = 0; i < cacheMap.size(); i++, it++) {
+        if (it == cacheMap.end()) {
+            it = cacheMap.begin();
+        }
+        if (it->second->issuePrefetch(this)) {
+            lastPrefetcher = it->first;
+            prefetchWaiting = true;
+            return;
+        }
+    }
+}
+
+void SerializingBus::busAcquired() {
+    stats.idleTicks += curTick() - lastBusyChange;
+    lastBusyChange = curTick();
+}
+
+void SerializingBus::busFreed() {
+    stats.busyTicks += curTick() - lastBusyChange;
+    lastBusyChange = curTick();
+}
+
 void SerializingBus::sendMemReqFunctional(PacketPtr pkt) {
+    for (auto& it : cacheMap) {
+        if (it.second->functionalAccess(pkt)) {
+            pkt->makeResponse();
+            return;
+        }
+    }
+    if (trySatisfyQueued(pkt)) {
+        pkt->makeResponse();
+        return;
+    }
     memPort.sendFunctional(pkt);
 }
 
-void SerializingBus::sendMemReq(PacketPtr pkt, bool sendToMemory) {
-    memReqQueue.push_back({pkt, sendToMemory});
-    schedule(memReqEvent, curTick()+1);
+bool SerializingBus::trySatisfyQueued(PacketPtr pkt) {
+    // only writes carry data, e.g. writebacks and uncached stores.
+    // Reads are satisfied by the newest one, writes update them all.
+    auto check = [pkt](PacketPtr queued) {
+        return queued->isWrite() && queued->hasData() &&
+               pkt->trySatisfyFunctional(queued);
+    };
+
+    // newest first: requests still in their address phase, then those
+    // parked behind a transaction to their line, then those sent on
+    for (size_t i = memReqQueue.size(); i-- > 0;) {
+        if (check(memReqQueue[i].pkt)) {
+            return true;
+        }
+    }
+    for (auto& line : pendingLines) {
+        for (size_t i = line.parked.size(); i-- > 0;) {
+            if (check(line.parked[i].pkt)) {
+                return true;
+            }
+        }
+    }
+    auto& waiting = memPort.waitingPackets;
+    for (size_t i = waiting.size(); i-- > 0;) {
+        if (check(waiting[i])) {
+            return true;
+        }
+    }
+    return memPort.blockedPacket && check(memPort.blockedPacket);
 }
 
-void SerializingBus::request(int cacheId) {
+void SerializingBus::sendMemReq(PacketPtr pkt, bool sendToMemory,
+                                bool uncacheable) {
+    assert(currentGranted != -1);
+    MemReq req{pkt, sendToMemory, true, currentGranted, uncacheable, 0};
+    if (atomicActive) {
+        atomicLatency += requestLatency(req);
+        startTransaction(req);
+        return;
+    }
+    grantUsed = true;
+    queueMemReq(req);
+}
+
+void SerializingBus::request(int cacheId, Tick since) {
     DPRINTF(SBus, "access request from %d\n\n", cacheId);
-    busRequestQueue.push_back(cacheId);
+    stats.queueDepth.sample(arbiter->size());
+    arbiter->request(cacheId, curTick(), since);
     // if there is no request currently being handled
     // start the grant process
-    if (currentGranted==-1 && !grantEvent.scheduled()) {
-        schedule(grantEvent, curTick()+1);
+    if (currentGranted==-1 && !inGrant && !grantEvent.scheduled()) {
+        schedule(grantEvent, curTick() + arbitrationLatency);
     }
 }
 
 void SerializingBus::release(int cacheId) {
     DPRINTF(SBus, "release from %d\n\n", cacheId);
+    // endAtomic hands the bus back
+    if (atomicActive) {
+        return;
+    }
+    // a split transaction bus is handed on after the address phase, only
+    // a grant that sent nothing comes back here
+    if (splitTransaction && (cacheId != currentGranted || grantUsed)) {
+        return;
+    }
+    assert(cacheId == currentGranted);
+    currentGranted = -1;
+    busFreed();
+    if (!grantEvent.scheduled()) {
+        schedule(grantEvent, curTick() + arbitrationLatency);
+    }
+}
+
+void SerializingBus::sendWriteback(int cacheId, PacketPtr pkt) {
+    DPRINTF(SBus, "sending writeback from %d @ %#x\n\n", cacheId, pkt->getAddr());
     assert(cacheId == currentGranted);
+    grantUsed = true;
+    queueMemReq({pkt, true, false, cacheId, false, 0});
+}
+
+void SerializingBus::beginAtomic(int cacheId) {
+    panic_if(currentGranted != -1 || !memReqQueue.empty() || outstanding,
+             "%s: atomic access while timing transactions are in flight\n",
+             name());
+    currentGranted = cacheId;
+    atomicActive = true;
+    atomicLatency = arbitrationLatency;
+}
+
+Tick SerializingBus::endAtomic(int cacheId) {
+    assert(atomicActive && cacheId == currentGranted);
     currentGranted = -1;
-    schedule(grantEvent, curTick()+1);
+    atomicActive = false;
+    return atomicLatency;
+}
+
+void SerializingBus::sendWritebackAtomic(PacketPtr pkt) {
+    DPRINTF(SBus, "atomic writeback @ %#x\n\n", pkt->getAddr());
+    memPort.sendAtomic(pkt);
+}
+
+void SerializingBus::lineFilled(int cacheId, Addr blk) {
+    if (directory) {
+        directory->addSharer(blk, cacheId);
+    }
+
+    Addr victim;
+    uint64_t holders;
+    if (snoopFilter && snoopFilter->addSharer(blk, cacheId, victim, holders)) {
+        // keep the filter inclusive, the holders report their drops back
+        DPRINTF(SBus, "snoop filter back-invalidating %#x\n\n", victim);
+        stats.backInvalidations++;
+        for (; holders; holders &= holders - 1) {
+            cacheMap[__builtin_ctzll(holders)]->backInvalidate(victim);
+        }
+    }
+}
+
+void SerializingBus::lineDropped(int cacheId, Addr blk) {
+    if (directory) {
+        directory->removeSharer(blk, cacheId);
+    }
+    if (snoopFilter) {
+        snoopFilter->removeSharer(blk, cacheId);
+        if (cacheMap[cacheId]->wbBuffer.empty()) {
+            snoopFilter->writebacksDrained(cacheId);
+        }
+    }
+}
+
+void SerializingBus::serialize(CheckpointOut& cp) const {
+    panic_if(!memReqQueue.empty() || outstanding || currentGranted != -1,
+             "%s: checkpoint with transactions in flight\n", name());
+    paramOut(cp, "block_size", blkSize);
+}
+
+void SerializingBus::unserialize(CheckpointIn& cp) {
+    unsigned cptBlkSize;
+    paramIn(cp, "block_size", cptBlkSize);
+    fatal_if(cptBlkSize != blkSize,
+             "%s: checkpoint block size %d, bus has %d\n", name(),
+             cptBlkSize, blkSize);
+}
+
+void SerializingBus::startup() {
+    checkCoherence();
 }
 
-void SerializingBus::sendWriteback(int cacheId, long addr, unsigned char data) {
-    DPRINTF(SBus, "sending writeback from %d @ %#x, %d\n\n", cacheId, addr, data);
-    RequestPtr req = std::make_shared<Request>(addr, 1, 0, 0);
-    PacketPtr new_pkt = new Packet(req, MemCmd::WriteReq, 1);
-    unsigned char* dataBlock = new unsigned char[1];
-    *dataBlock = data;
-    new_pkt->dataDynamic(dataBlock);
-    memPort.sendFunctional(new_pkt);
+void SerializingBus::checkCoherence() const {
+    struct Copies {
+        unsigned valid = 0;
+        unsigned owned = 0;
+        unsigned forward = 0;
+        unsigned exclusive = 0;
+        const uint8_t* data = nullptr;
+    };
+    std::map<Addr, Copies> blocks;
+
+    for (auto& it : cacheMap) {
+        CoherentCacheBase* cache = it.second;
+        for (unsigned line = 0; line < cache->states.size(); line++) {
+            Addr blk = cache->tags[line];
+            if (cache->states[line] == 0 || cache->busFor(blk) != this) {
+                continue;
+            }
+
+            auto sharing = cache->sharing(line);
+            fatal_if(sharing == CoherentCacheBase::Sharing::Invalid,
+                     "%s: C[%d] holds %#x in unknown state %d\n", name(),
+                     it.first, blk, cache->states[line]);
+
+            Copies& copies = blocks[blk];
+            const uint8_t* data = cache->lineData(line);
+            fatal_if(copies.data &&
+                     std::memcmp(copies.data, data, blkSize) != 0,
+                     "%s: copies of %#x hold different data\n", name(),
+                     blk);
+            copies.data = data;
+            copies.valid++;
+            copies.owned += sharing == CoherentCacheBase::Sharing::Owned;
+            copies.forward += sharing == CoherentCacheBase::Sharing::Forward;
+            copies.exclusive +=
+                sharing == CoherentCacheBase::Sharing::Exclusive;
+
+            fatal_if(copies.owned > 1 || copies.forward > 1 ||
+                     (copies.exclusive && copies.valid > 1),
+                     "%s: C[%d] state %d for %#x conflicts with another "
+                     "cache\n", name(), it.first, cache->states[line], blk);
+        }
+    }
+    DPRINTF(SBus, "%d lines checked for coherence\n\n", blocks.size());
 }
 
 }
\ No newline at end of file
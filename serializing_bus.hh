@@ -1,11 +1,20 @@
 #pragma once
 
+#include "base/intmath.hh"
+#include "base/statistics.hh"
 #include "mem/port.hh"
 #include "params/SerializingBus.hh"
 #include "sim/sim_object.hh"
+#include "src_740/bus_arbiter.hh"
+#include "src_740/coherence_directory.hh"
+#include "src_740/coherence_trace.hh"
 #include "src_740/coherent_cache_base.hh"
-#include <list>
+#include "src_740/ring_queue.hh"
+#include "src_740/snoop_filter.hh"
+#include <cstring>
 #include <map>
+#include <memory>
+#include <vector>
 
 namespace gem5 {
 
@@ -18,6 +27,9 @@ class SerializingBus : public SimObject {
        public:
         SerializingBus *owner;
         PacketPtr blockedPacket = nullptr;
+        // several requests can be in flight in split transaction mode,
+        // the ones behind a refused request wait here in order
+        RingQueue<PacketPtr> waitingPackets;
 
         MemSidePort(const std::string &name, SerializingBus *owner)
             : RequestPort(name, owner), owner(owner) {}
@@ -31,17 +43,110 @@ class SerializingBus : public SimObject {
 
     MemSidePort memPort;
 
-    std::list<std::pair<PacketPtr, bool>> memReqQueue;
+    struct MemReq {
+        PacketPtr pkt;
+        bool sendToMemory;
+        bool snoop;
+        int cacheId;  // requester, gets the response
+        bool uncacheable;
+        Tick ready;  // end of the address phase
+    };
+    // in order, a request never overtakes an earlier one. One event
+    // serves them all, it is scheduled for the front request.
+    RingQueue<MemReq> memReqQueue;
     EventFunctionWrapper memReqEvent;
     void processMemReqEvent();
+    void queueMemReq(MemReq req);
+
+    // a request starts after its address phase: the slowest snooper's tag
+    // lookup and the transfer of any data it carries. Response data is
+    // charged to the requester through payloadDelay.
+    const Tick arbitrationLatency;
+    const unsigned busWidth;
+    const Tick beatLatency;
+    Tick snoopLatency = 0;  // max over the registered caches
+    Tick transferLatency(unsigned bytes) const {
+        return divCeil(bytes, busWidth) * beatLatency;
+    }
+    Tick requestLatency(const MemReq &req) const;
+
+    // snoops the other caches and then answers the request, or sends it
+    // on to memory
+    void startTransaction(const MemReq &req);
+    void deliverResponse(int cacheId, PacketPtr pkt);
+
+    // split transaction mode: the bus is handed on after the address
+    // (snoop) phase, memory responses come back tagged with the requester.
+    // A request to a block that already has a transaction in flight waits
+    // in pendingLines behind it, so its snoop sees the earlier outcome.
+    // Both are preallocated for max_outstanding transactions, so split
+    // mode does not allocate per transaction either.
+    struct BusSenderState : public Packet::SenderState {
+        int cacheId = -1;
+    };
+    std::vector<BusSenderState> senderStates;
+    std::vector<BusSenderState*> freeSenderStates;
+
+    struct PendingLine {
+        Addr blk = 0;
+        bool busy = false;
+        RingQueue<MemReq> parked;  // waiting behind the transaction
+    };
 
-    std::list<int> busRequestQueue;
+    bool splitTransaction;
+    unsigned maxOutstanding;
+    unsigned outstanding = 0;  // past the address phase, not yet answered
+    bool grantUsed = false;  // the current grant has sent its request
+    unsigned blkSize;
+    std::vector<PendingLine> pendingLines;  // searched, a few entries
+    PendingLine* findPending(Addr blk);
+    PendingLine* claimPending(Addr blk);
+
+    Addr blockAlign(Addr addr) const { return addr & ~Addr(blkSize - 1); }
+    void endAddressPhase();
+
+    // atomic mode: one transaction at a time, done inline while the
+    // requester holds the bus between beginAtomic and endAtomic
+    bool atomicActive = false;
+    Tick atomicLatency = 0;
+    void beginAtomic(int cacheId);
+    Tick endAtomic(int cacheId);
+    void sendWritebackAtomic(PacketPtr pkt);
+
+    std::unique_ptr<BusArbiter> arbiter;
     int currentGranted = -1;
     EventFunctionWrapper grantEvent;
     void processGrantEvent();
+    // set while the grant event runs, which is no longer scheduled then.
+    // Requests made from it are granted by it, not by another event.
+    bool inGrant = false;
+
+    // prefetches only get an idle slice: when no request is queued at a
+    // grant, the caches are asked in turn for one
+    bool prefetchWaiting = false;
+    int lastPrefetcher = -1;
+    void prefetchReady();
+    void offerIdle();
+
+    // the bus is busy from a grant until it is released, or until the
+    // address phase ends on a split transaction bus
+    Tick lastBusyChange = 0;
+    void busAcquired();
+    void busFreed();
 
     std::map<int, CoherentCacheBase*> cacheMap;
 
+    // whether clean (E/S) copies may supply data, dirty ones always do
+    bool forwardClean;
+
+    // optional, limits snoops to the caches that may hold the line
+    CoherenceDirectory* directory;
+    // optional and inclusive, a replaced entry back-invalidates its line
+    std::unique_ptr<SnoopFilter> snoopFilter;
+    CoherenceTrace* trace;  // optional
+    void snoopTargets(const MemReq &req, std::vector<int> &targets);
+    std::vector<int> snoopScratch;  // reused for every transaction
+
     SerializingBus(const SerializingBusParams &params);
 
     Port &getPort(const std::string &port_name,
@@ -50,15 +155,60 @@ class SerializingBus : public SimObject {
     AddrRangeList getAddrRanges() const;
     void sendRangeChange();
 
+    // a drained bus holds no transactions, the directory and snoop filter
+    // are rebuilt from the restored caches. startup() checks that the
+    // caches agree on every line of this slice.
+    void serialize(CheckpointOut &cp) const override;
+    void unserialize(CheckpointIn &cp) override;
+    void startup() override;
+    void checkCoherence() const;
+
     bool handleResponse(PacketPtr pkt);
+    // checks every cache and the requests still queued in the bus before
+    // memory, a dirty line or a writeback on its way is newer than memory
     void sendMemReqFunctional(PacketPtr pkt);
+    bool trySatisfyQueued(PacketPtr pkt);
 
 
     // public API
-    void sendMemReq(PacketPtr pkt, bool sendToMemory);
+    void sendMemReq(PacketPtr pkt, bool sendToMemory,
+                    bool uncacheable = false);
     void registerCache(int cacheId, CoherentCacheBase* cache);
-    void request(int cacheId);
+    // since: when the work behind the request first needed the bus
+    void request(int cacheId, Tick since);
     void release(int cacheId);
-    void sendWriteback(int cacheId, long addr, unsigned char data);
+    // sends a buffered writeback to memory without snooping other caches,
+    // only one cache can hold the line dirty
+    void sendWriteback(int cacheId, PacketPtr pkt);
+    // a cache allocated a line, or no longer holds it nor a buffered
+    // writeback of it
+    void lineFilled(int cacheId, Addr blk);
+    void lineDropped(int cacheId, Addr blk);
+
+    struct SerializingBusStats : public statistics::Group {
+        SerializingBusStats(statistics::Group *parent);
+
+        statistics::Scalar snoopsSent;
+        statistics::Scalar snoopsFiltered;
+        statistics::Formula filteredFraction;
+        statistics::Scalar backInvalidations;
+        statistics::Scalar busyTicks;
+        statistics::Scalar idleTicks;
+        statistics::Formula utilization;
+        statistics::Histogram queueDepth;  // tokens queued, per request
+        statistics::Histogram grantWait;  // all caches, see busGrantWait
+        // by type: read, write/invalidate, update, uncacheable, writeback
+        statistics::Vector transactions;
+        // data moved by each type, request and response payloads. Compare
+        // the totals of two protocols on the same workload.
+        statistics::Vector bytes;
+        statistics::Scalar cacheSupplied;
+        statistics::Histogram snoopsPerTransaction;
+    } stats;
+
+    // transaction types in stats.transactions
+    enum TransType {
+        Read, WriteInv, Update, Uncacheable, Writeback, NumTransTypes
+    };
 };
 }
\ No newline at end of file
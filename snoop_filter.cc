@@ -0,0 +1,129 @@
+#include "src_740/snoop_filter.hh"
+#include "base/intmath.hh"
+#include "base/logging.hh"
+
+namespace gem5 {
+
+SnoopFilter::SnoopFilter(unsigned entries, unsigned assoc, unsigned blkSize)
+    : assoc(assoc), blkBits(floorLog2(blkSize)) {
+    fatal_if(assoc == 0 || entries % assoc,
+             "snoop filter entries must be a multiple of its assoc\n");
+    numSets = entries / assoc;
+    fatal_if(!isPowerOf2(numSets),
+             "snoop filter number of sets must be a power of 2\n");
+
+    tags.assign(entries, 0);
+    presence.assign(entries, 0);
+    drainTags.assign(entries, 0);
+    drainHolders.assign(entries, 0);
+    pinned.assign(assoc, 0);
+    replPolicy = ReplPolicy::create(enums::CoherentReplPolicy::LRU,
+                                    numSets, assoc);
+}
+
+int SnoopFilter::findEntry(Addr blk) const {
+    unsigned base = setIndex(blk) * assoc;
+    for (unsigned way = 0; way < assoc; way++) {
+        unsigned entry = base + way;
+        if (presence[entry] != 0 && tags[entry] == blk) {
+            return entry;
+        }
+    }
+    return -1;
+}
+
+int SnoopFilter::findDrain(Addr blk) const {
+    unsigned base = setIndex(blk) * assoc;
+    for (unsigned way = 0; way < assoc; way++) {
+        unsigned entry = base + way;
+        if (drainHolders[entry] != 0 && drainTags[entry] == blk) {
+            return entry;
+        }
+    }
+    return -1;
+}
+
+void SnoopFilter::lookup(Addr blk, int requester,
+                         std::vector<int>& targets) {
+    uint64_t holders = 0;
+    int entry = findEntry(blk);
+    if (entry >= 0) {
+        holders = presence[entry];
+        replPolicy->touch(entry);
+    }
+    int drain = findDrain(blk);
+    if (drain >= 0) {
+        holders |= drainHolders[drain];
+    }
+    holders |= overflow;
+
+    holders &= ~(uint64_t(1) << requester);
+    for (; holders; holders &= holders - 1) {
+        targets.push_back(__builtin_ctzll(holders));
+    }
+}
+
+bool SnoopFilter::addSharer(Addr blk, int cacheId, Addr& victim,
+                            uint64_t& holders) {
+    uint64_t bit = uint64_t(1) << cacheId;
+    int entry = findEntry(blk);
+    if (entry >= 0) {
+        presence[entry] |= bit;
+        replPolicy->touch(entry);
+        return false;
+    }
+
+    unsigned set = setIndex(blk);
+    unsigned base = set * assoc;
+    bool replaced = false;
+    entry = -1;
+    for (unsigned way = 0; way < assoc; way++) {
+        if (presence[base + way] == 0) {
+            entry = base + way;
+            break;
+        }
+    }
+    if (entry < 0) {
+        // keep the lines still draining tracked
+        unsigned busy = 0;
+        for (unsigned way = 0; way < assoc; way++) {
+            pinned[way] = drainHolders[base + way] != 0;
+            busy += pinned[way];
+        }
+        entry = replPolicy->victim(set, busy && busy < assoc
+                                            ? pinned.data() : nullptr);
+        victim = tags[entry];
+        holders = presence[entry];
+        // tracked here until every holder reports the drop
+        if (drainHolders[entry] == 0) {
+            drainTags[entry] = victim;
+            drainHolders[entry] = holders;
+        } else {
+            overflow |= holders;
+        }
+        replaced = true;
+    }
+
+    tags[entry] = blk;
+    presence[entry] = bit;
+    replPolicy->insert(entry);
+    return replaced;
+}
+
+void SnoopFilter::removeSharer(Addr blk, int cacheId) {
+    uint64_t bit = uint64_t(1) << cacheId;
+    int entry = findEntry(blk);
+    if (entry >= 0) {
+        presence[entry] &= ~bit;
+        if (presence[entry] == 0) {
+            replPolicy->invalidate(entry);
+        }
+    }
+
+    int drain = findDrain(blk);
+    if (drain >= 0) {
+        drainHolders[drain] &= ~bit;
+    }
+}
+
+}
@@ -0,0 +1,66 @@
+#pragma once
+
+#include "base/types.hh"
+#include "src_740/replacement_policy.hh"
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace gem5 {
+
+// Presence filter kept by SerializingBus, inclusive of all private
+// caches: a line is only snooped in the caches whose bit is set, a line
+// with no entry is not snooped at all. Set-associative with one presence
+// word per entry (one bit per cache id, so at most 64 caches).
+// Entries are replaced LRU. The victim's line has to be back-invalidated
+// in its holders, see addSharer, and is snooped until they drop it.
+class SnoopFilter {
+   public:
+    SnoopFilter(unsigned entries, unsigned assoc, unsigned blkSize);
+
+    static const int maxCaches = 64;
+
+    // appends the caches other than requester that may hold blk
+    void lookup(Addr blk, int requester, std::vector<int> &targets);
+
+    // records that cacheId allocated blk. Returns true if an entry had
+    // to be replaced: victim is its line and holders the caches that must
+    // drop it.
+    bool addSharer(Addr blk, int cacheId, Addr &victim, uint64_t &holders);
+
+    // cacheId holds neither the line nor a buffered writeback of it
+    void removeSharer(Addr blk, int cacheId);
+
+    // cacheId's writeback buffer is empty, none of its lines can still be
+    // draining
+    void writebacksDrained(int cacheId) {
+        overflow &= ~(uint64_t(1) << cacheId);
+    }
+
+   private:
+    unsigned numSets;
+    unsigned assoc;
+    unsigned blkBits;
+    std::vector<Addr> tags;
+    std::vector<uint64_t> presence;  // 0 is a free entry
+    std::unique_ptr<ReplPolicy> replPolicy;
+
+    // back-invalidated lines still waiting in some writeback buffer, they
+    // are snooped until the writeback leaves. One slot per entry, for the
+    // last line replaced there. An entry whose slot is busy is not
+    // replaced unless every way of the set is draining, then the holders
+    // go to overflow and are snooped for every line until their writeback
+    // buffers are empty.
+    std::vector<Addr> drainTags;
+    std::vector<uint64_t> drainHolders;  // 0 is a free slot
+    uint64_t overflow = 0;
+    std::vector<uint8_t> pinned;  // per way, reused
+
+    unsigned setIndex(Addr blk) const {
+        return (blk >> blkBits) & (numSets - 1);
+    }
+    int findEntry(Addr blk) const;
+    int findDrain(Addr blk) const;
+};
+}